@@ -0,0 +1,159 @@
+//
+// Builds instruction sequences in the Generator's (binary, assembly) form from mnemonics and operands.
+//
+
+#include "Assembler.h"
+#include "Disassembler.h"
+#include <bitset>
+#include <stdexcept>
+#include <cstdio>
+
+using namespace std;
+
+namespace {
+    // opcode and function bits of every RV32I (and register Zicsr) instruction the assembler knows
+    const pair<const char *, uint32_t> OPCODES[] = {
+        {"add", 0x00000033}, {"sub", 0x40000033}, {"sll", 0x00001033}, {"slt", 0x00002033},
+        {"sltu", 0x00003033}, {"xor", 0x00004033}, {"srl", 0x00005033}, {"sra", 0x40005033},
+        {"or", 0x00006033}, {"and", 0x00007033},
+        {"addi", 0x00000013}, {"slti", 0x00002013}, {"sltiu", 0x00003013}, {"xori", 0x00004013},
+        {"ori", 0x00006013}, {"andi", 0x00007013}, {"slli", 0x00001013}, {"srli", 0x00005013},
+        {"srai", 0x40005013},
+        {"lb", 0x00000003}, {"lh", 0x00001003}, {"lw", 0x00002003}, {"lbu", 0x00004003},
+        {"lhu", 0x00005003}, {"jalr", 0x00000067},
+        {"sb", 0x00000023}, {"sh", 0x00001023}, {"sw", 0x00002023},
+        {"beq", 0x00000063}, {"bne", 0x00001063}, {"blt", 0x00004063}, {"bge", 0x00005063},
+        {"bltu", 0x00006063}, {"bgeu", 0x00007063},
+        {"lui", 0x00000037}, {"auipc", 0x00000017}, {"jal", 0x0000006F},
+        {"csrrw", 0x00001073}, {"csrrs", 0x00002073}, {"csrrc", 0x00003073},
+    };
+}
+
+uint32_t Assembler::Encode(const string &name, int rd, int rs1, int rs2, int32_t imm) {
+    for (auto &op : OPCODES) {
+        if (name == op.first) {
+            DecodedInstr d = Decode(op.second);
+            d.rd = rd;
+            d.rs1 = rs1;
+            d.rs2 = rs2;
+            d.imm = imm;
+            return ::Encode(d);
+        }
+    }
+    throw invalid_argument("unknown mnemonic " + name);
+}
+
+void Assembler::R(const string &name, int rd, int rs1, int rs2) {
+    Emit(Encode(name, rd, rs1, rs2, 0));
+}
+
+void Assembler::I(const string &name, int rd, int rs1, int32_t imm) {
+    Emit(Encode(name, rd, rs1, 0, imm));
+}
+
+void Assembler::Csr(const string &name, int rd, int csr, int rs1) {
+    Emit(Encode(name, rd, rs1, 0, csr));
+}
+
+void Assembler::S(const string &name, int rs2, int rs1, int32_t imm) {
+    Emit(Encode(name, 0, rs1, rs2, imm));
+}
+
+void Assembler::B(const string &name, int rs1, int rs2, int32_t offset) {
+    Emit(Encode(name, 0, rs1, rs2, offset));
+}
+
+void Assembler::U(const string &name, int rd, int32_t imm20) {
+    Emit(Encode(name, rd, 0, 0, imm20));
+}
+
+void Assembler::J(int rd, int32_t offset) {
+    Emit(Encode("jal", rd, 0, 0, offset));
+}
+
+void Assembler::Li(int rd, uint32_t value) {
+    // addi sign extends, so round the upper part up when bit 11 is set
+    int32_t lo = static_cast<int32_t>(value << 20) >> 20;
+    uint32_t hi = (value - static_cast<uint32_t>(lo)) >> 12;
+    U("lui", rd, static_cast<int32_t>(hi));
+    I("addi", rd, rd, lo);
+}
+
+void Assembler::Emit(uint32_t word) {
+    program.emplace_back(bitset<32>(word).to_string(), Disassemble(word));
+}
+
+void Assembler::Set(size_t index, uint32_t word) {
+    program[index] = {bitset<32>(word).to_string(), Disassemble(word)};
+}
+
+void Assembler::Label(const string &label) {
+    labels[label] = program.size();
+}
+
+void Assembler::B(const string &name, int rs1, int rs2, const string &label) {
+    fixups.push_back({'B', program.size(), label, name, 0, rs1, rs2});
+    B(name, rs1, rs2, 0);
+}
+
+void Assembler::J(int rd, const string &label) {
+    fixups.push_back({'J', program.size(), label, "jal", rd, 0, 0});
+    J(rd, 0);
+}
+
+void Assembler::La(int rd, const string &label) {
+    fixups.push_back({'A', program.size(), label, "auipc", rd, 0, 0});
+    U("auipc", rd, 0);
+    I("addi", rd, rd, 0);
+}
+
+void Assembler::Word(uint32_t value) {
+    char text[24];
+    snprintf(text, sizeof(text), ".word 0x%08x", value);
+    program.emplace_back(bitset<32>(value).to_string(), text);
+}
+
+void Assembler::WordAddress(const string &label) {
+    fixups.push_back({'W', program.size(), label, "", 0, 0, 0});
+    Word(0);
+}
+
+bool Assembler::Resolve(uint32_t baseAddress, string &error) {
+    for (auto &f : fixups) {
+        auto it = labels.find(f.label);
+        if (it == labels.end()) {
+            error = "undefined label " + f.label;
+            return false;
+        }
+        int64_t offset = (static_cast<int64_t>(it->second) - static_cast<int64_t>(f.index)) * 4;
+
+        switch (f.kind) {
+            case 'B':
+                if (offset < -4096 || offset > 4094) {
+                    error = "branch to " + f.label + " out of range";
+                    return false;
+                }
+                Set(f.index, Encode(f.name, 0, f.rs1, f.rs2, static_cast<int32_t>(offset)));
+                break;
+            case 'J':
+                Set(f.index, Encode("jal", f.rd, 0, 0, static_cast<int32_t>(offset)));
+                break;
+            case 'A': {
+                int32_t lo = static_cast<int32_t>(static_cast<uint32_t>(offset) << 20) >> 20;
+                int32_t hi = static_cast<int32_t>((offset - lo) >> 12);
+                Set(f.index, Encode("auipc", f.rd, 0, 0, hi));
+                Set(f.index + 1, Encode("addi", f.rd, f.rd, 0, lo));
+                break;
+            }
+            default: {
+                uint32_t address = baseAddress + static_cast<uint32_t>(it->second * 4);
+                char text[24];
+                snprintf(text, sizeof(text), ".word 0x%08x", address);
+                program[f.index] = {bitset<32>(address).to_string(), text};
+                break;
+            }
+        }
+    }
+    fixups.clear();
+    return true;
+}
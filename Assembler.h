@@ -0,0 +1,61 @@
+//
+// Builds instruction sequences in the Generator's (binary, assembly) form from mnemonics and operands.
+//
+
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <map>
+
+using namespace std;
+
+
+// Branches, jumps and address loads may refer to labels placed later; Resolve() patches them
+// once the whole program is emitted.
+class Assembler {
+private:
+    struct Fixup {
+        char kind;   // B branch, J jal, A auipc+addi pair, W data word holding an address
+        size_t index;
+        string label;
+        string name; // branch mnemonic
+        int rd, rs1, rs2;
+    };
+
+    vector<pair<string,string>> program;
+    map<string, size_t> labels; // label -> instruction index
+    vector<Fixup> fixups;
+
+    void Set(size_t index, uint32_t word);
+
+public:
+    // Encodes one RV32I instruction; operands that the format does not have are ignored
+    static uint32_t Encode(const string &name, int rd, int rs1, int rs2, int32_t imm);
+
+    void R(const string &name, int rd, int rs1, int rs2);
+    void I(const string &name, int rd, int rs1, int32_t imm); // ALU immediates, shifts, loads and jalr
+    void Csr(const string &name, int rd, int csr, int rs1);   // csrrw, csrrs, csrrc
+    void S(const string &name, int rs2, int rs1, int32_t imm);
+    void B(const string &name, int rs1, int rs2, int32_t offset);
+    void U(const string &name, int rd, int32_t imm20);
+    void J(int rd, int32_t offset);
+    void Li(int rd, uint32_t value); // lui + addi
+    void Emit(uint32_t word);
+
+    void Label(const string &label);
+    void B(const string &name, int rs1, int rs2, const string &label);
+    void J(int rd, const string &label);
+    void La(int rd, const string &label);        // auipc + addi, position independent
+    void Word(uint32_t value);                   // data, written as ".word"
+    void WordAddress(const string &label);       // data word holding a label's absolute address
+    bool Resolve(uint32_t baseAddress, string &error);
+
+    size_t Size() const { return program.size(); }
+    vector<pair<string,string>> &Program() { return program; }
+};
+
+
+#endif //ASSEMBLER_H
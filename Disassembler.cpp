@@ -0,0 +1,361 @@
+//
+// RV32I (plus Zicsr) decoder and disassembler. The assembly it prints follows the Generator's formatting,
+// so decoded words can be compared against the "// assembly" comments of TC files.
+//
+
+#include "Disassembler.h"
+#include <cstdio>
+#include <cctype>
+
+using namespace std;
+
+namespace {
+    int32_t signExtend(uint32_t value, int bits) {
+        uint32_t m = 1u << (bits - 1);
+        value &= (bits == 32) ? 0xFFFFFFFFu : ((1u << bits) - 1);
+        return static_cast<int32_t>((value ^ m) - m);
+    }
+
+    bool sameName(string_view a, string_view b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) return false;
+        }
+        return true;
+    }
+
+    const char *ABI_NAMES[32] = {
+        "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+        "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+    };
+
+    // register (x5, t0, fp) or number (12, -4, 0x1F); fence operands (rw, iorw) become their bit mask
+    bool parseOperand(string_view tok, int64_t &value) {
+        if (tok.empty()) return false;
+        if ((tok[0] == 'x' || tok[0] == 'X') && tok.size() >= 2 && isdigit(static_cast<unsigned char>(tok[1]))) {
+            int reg = 0;
+            for (size_t i = 1; i < tok.size(); ++i) {
+                if (!isdigit(static_cast<unsigned char>(tok[i]))) return false;
+                reg = reg * 10 + (tok[i] - '0');
+            }
+            if (reg > 31) return false;
+            value = reg;
+            return true;
+        }
+        for (int r = 0; r < 32; ++r) {
+            if (sameName(tok, ABI_NAMES[r])) { value = r; return true; }
+        }
+        if (sameName(tok, "fp")) { value = 8; return true; }
+
+        bool neg = false;
+        size_t i = 0;
+        if (tok[0] == '-' || tok[0] == '+') { neg = tok[0] == '-'; i = 1; }
+        if (i >= tok.size()) return false;
+
+        int64_t v = 0;
+        if (tok.size() > i + 2 && tok[i] == '0' && (tok[i + 1] == 'x' || tok[i + 1] == 'X')) {
+            for (i += 2; i < tok.size(); ++i) {
+                char c = static_cast<char>(tolower(static_cast<unsigned char>(tok[i])));
+                if (isdigit(static_cast<unsigned char>(c))) v = v * 16 + (c - '0');
+                else if (c >= 'a' && c <= 'f') v = v * 16 + (c - 'a' + 10);
+                else return false;
+            }
+        } else if (isdigit(static_cast<unsigned char>(tok[i]))) {
+            for (; i < tok.size(); ++i) {
+                if (!isdigit(static_cast<unsigned char>(tok[i]))) return false;
+                v = v * 10 + (tok[i] - '0');
+            }
+        } else {
+            // i/o/r/w fence sets
+            for (; i < tok.size(); ++i) {
+                switch (tolower(static_cast<unsigned char>(tok[i]))) {
+                    case 'i': v |= 8; break;
+                    case 'o': v |= 4; break;
+                    case 'r': v |= 2; break;
+                    case 'w': v |= 1; break;
+                    default: return false;
+                }
+            }
+        }
+        value = neg ? -v : v;
+        return true;
+    }
+
+    const char *MNEMONICS[] = {
+        "lui", "auipc", "jal", "jalr", "beq", "bne", "blt", "bge", "bltu", "bgeu",
+        "lb", "lh", "lw", "lbu", "lhu", "sb", "sh", "sw",
+        "addi", "slti", "sltiu", "xori", "ori", "andi", "slli", "srli", "srai",
+        "add", "sub", "sll", "slt", "sltu", "xor", "srl", "sra", "or", "and",
+        "fence", "fence.tso", "pause", "ecall", "ebreak",
+        "csrrw", "csrrs", "csrrc", "csrrwi", "csrrsi", "csrrci", ".word", "nop", "j", "mv", "ret"
+    };
+
+    bool isMnemonic(string_view name) {
+        for (const char *m : MNEMONICS) {
+            if (sameName(name, m)) return true;
+        }
+        return false;
+    }
+
+    string fenceSet(int bits) {
+        string s;
+        if (bits & 8) s += 'i';
+        if (bits & 4) s += 'o';
+        if (bits & 2) s += 'r';
+        if (bits & 1) s += 'w';
+        return s.empty() ? "0" : s;
+    }
+}
+
+DecodedInstr Decode(uint32_t word) {
+    DecodedInstr d;
+    d.word = word;
+    uint32_t opcode = word & 0x7F;
+    d.rd = (word >> 7) & 0x1F;
+    uint32_t funct3 = (word >> 12) & 0x7;
+    d.rs1 = (word >> 15) & 0x1F;
+    d.rs2 = (word >> 20) & 0x1F;
+    uint32_t funct7 = word >> 25;
+
+    auto set = [&](const char *name, char format, int32_t imm) {
+        d.name = name;
+        d.format = format;
+        d.imm = imm;
+        d.valid = true;
+    };
+
+    switch (opcode) {
+        case 0x37: set("lui", 'U', signExtend(word >> 12, 20)); break;
+        case 0x17: set("auipc", 'U', signExtend(word >> 12, 20)); break;
+        case 0x6F: {
+            uint32_t imm = ((word >> 31) & 0x1) << 20 | ((word >> 12) & 0xFF) << 12 |
+                           ((word >> 20) & 0x1) << 11 | ((word >> 21) & 0x3FF) << 1;
+            set("jal", 'J', signExtend(imm, 21));
+            break;
+        }
+        case 0x67:
+            if (funct3 == 0) set("jalr", 'L', signExtend(word >> 20, 12));
+            break;
+        case 0x63: {
+            static const char *names[8] = {"beq", "bne", nullptr, nullptr, "blt", "bge", "bltu", "bgeu"};
+            uint32_t imm = ((word >> 31) & 0x1) << 12 | ((word >> 7) & 0x1) << 11 |
+                           ((word >> 25) & 0x3F) << 5 | ((word >> 8) & 0xF) << 1;
+            if (names[funct3]) set(names[funct3], 'B', signExtend(imm, 13));
+            break;
+        }
+        case 0x03: {
+            static const char *names[8] = {"lb", "lh", "lw", nullptr, "lbu", "lhu", nullptr, nullptr};
+            if (names[funct3]) set(names[funct3], 'L', signExtend(word >> 20, 12));
+            break;
+        }
+        case 0x23: {
+            static const char *names[8] = {"sb", "sh", "sw", nullptr, nullptr, nullptr, nullptr, nullptr};
+            uint32_t imm = (word >> 25) << 5 | ((word >> 7) & 0x1F);
+            if (names[funct3]) set(names[funct3], 'S', signExtend(imm, 12));
+            break;
+        }
+        case 0x13: {
+            static const char *names[8] = {"addi", nullptr, "slti", "sltiu", "xori", nullptr, "ori", "andi"};
+            if (funct3 == 1) {
+                if (funct7 == 0) set("slli", 'I', d.rs2);
+            } else if (funct3 == 5) {
+                if (funct7 == 0) set("srli", 'I', d.rs2);
+                else if (funct7 == 0x20) set("srai", 'I', d.rs2);
+            } else {
+                set(names[funct3], 'I', signExtend(word >> 20, 12));
+            }
+            break;
+        }
+        case 0x33: {
+            static const char *base[8] = {"add", "sll", "slt", "sltu", "xor", "srl", "or", "and"};
+            if (funct7 == 0) set(base[funct3], 'R', 0);
+            else if (funct7 == 0x20 && funct3 == 0) set("sub", 'R', 0);
+            else if (funct7 == 0x20 && funct3 == 5) set("sra", 'R', 0);
+            break;
+        }
+        case 0x0F:
+            if (word == 0x0330000Fu) set("FENCE", 'Y', 0);
+            else if (word == 0x8330000Fu) set("FENCE.TSO", 'Y', 0);
+            else if (word == 0x0100000Fu) set("PAUSE", 'Y', 0);
+            else if (funct3 == 0) set("fence", 'Y', 0);
+            break;
+        case 0x73:
+            if (word == 0x00000073u) set("ECALL", 'Y', 0);
+            else if (word == 0x00100073u) set("EBREAK", 'Y', 0);
+            else if (funct3 != 0 && funct3 != 4) {
+                // Zicsr, the CSR number sits where I-type keeps its immediate
+                static const char *csr[8] = {"", "csrrw", "csrrs", "csrrc", "", "csrrwi", "csrrsi", "csrrci"};
+                set(csr[funct3], 'Z', static_cast<int32_t>(word >> 20));
+            }
+            break;
+        default:
+            break;
+    }
+    return d;
+}
+
+uint32_t Encode(const DecodedInstr &d) {
+    uint32_t w = d.word;
+    uint32_t imm = static_cast<uint32_t>(d.imm);
+    uint32_t rd = static_cast<uint32_t>(d.rd) & 0x1F;
+    uint32_t rs1 = static_cast<uint32_t>(d.rs1) & 0x1F;
+    uint32_t rs2 = static_cast<uint32_t>(d.rs2) & 0x1F;
+
+    switch (d.format) {
+        case 'R':
+            return (w & 0xFE00707Fu) | rs2 << 20 | rs1 << 15 | rd << 7;
+        case 'I':
+            if ((w & 0x3000) == 0x1000) { // slli, srli, srai keep funct7 above the shift amount
+                return (w & 0xFE00707Fu) | (imm & 0x1F) << 20 | rs1 << 15 | rd << 7;
+            }
+            return (w & 0x0000707Fu) | (imm & 0xFFF) << 20 | rs1 << 15 | rd << 7;
+        case 'L':
+        case 'Z':
+            return (w & 0x0000707Fu) | (imm & 0xFFF) << 20 | rs1 << 15 | rd << 7;
+        case 'S':
+            return (w & 0x0000707Fu) | ((imm >> 5) & 0x7F) << 25 | rs2 << 20 | rs1 << 15 | (imm & 0x1F) << 7;
+        case 'B':
+            return (w & 0x0000707Fu) | ((imm >> 12) & 0x1) << 31 | ((imm >> 5) & 0x3F) << 25 | rs2 << 20 |
+                   rs1 << 15 | ((imm >> 1) & 0xF) << 8 | ((imm >> 11) & 0x1) << 7;
+        case 'U':
+            return (w & 0x7Fu) | (imm & 0xFFFFF) << 12 | rd << 7;
+        case 'J':
+            return (w & 0x7Fu) | ((imm >> 20) & 0x1) << 31 | ((imm >> 1) & 0x3FF) << 21 |
+                   ((imm >> 11) & 0x1) << 20 | ((imm >> 12) & 0xFF) << 12 | rd << 7;
+        default:
+            return w;
+    }
+}
+
+string FormatAssembly(const DecodedInstr &d) {
+    string name = d.name;
+    string rd = "x" + to_string(d.rd);
+    string rs1 = "x" + to_string(d.rs1);
+    string rs2 = "x" + to_string(d.rs2);
+    string imm = to_string(d.imm);
+
+    switch (d.format) {
+        case 'R': return name + " " + rd + ", " + rs1 + ", " + rs2;
+        case 'I': return name + " " + rd + ", " + rs1 + ", " + imm;
+        case 'L': return name + " " + rd + ", " + imm + "(" + rs1 + ")";
+        case 'S': return name + " " + rs2 + ", " + imm + "(" + rs1 + ")";
+        case 'B': return name + " " + rs1 + ", " + rs2 + ", " + imm;
+        case 'U':
+        case 'J': return name + " " + rd + ", " + imm;
+        case 'Y':
+            if (name == "fence") {
+                return name + " " + fenceSet((d.word >> 24) & 0xF) + ", " + fenceSet((d.word >> 20) & 0xF);
+            }
+            return name;
+        case 'Z': {
+            // csrrs x5, 0xf14, x0; the immediate forms take a 5-bit value instead of rs1
+            char csr[8];
+            snprintf(csr, sizeof(csr), "0x%03x", static_cast<unsigned>(d.imm) & 0xFFF);
+            return name + " " + rd + ", " + csr + ", " + (name.back() == 'i' ? to_string(d.rs1) : rs1);
+        }
+        default: {
+            char buf[24];
+            snprintf(buf, sizeof(buf), ".word 0x%08x", d.word);
+            return buf;
+        }
+    }
+}
+
+string Disassemble(uint32_t word) {
+    return FormatAssembly(Decode(word));
+}
+
+ParsedAsm ParseAssembly(string_view text) {
+    ParsedAsm p;
+
+    size_t cut = text.find_first_of(";#");
+    if (cut != string_view::npos) text = text.substr(0, cut);
+
+    size_t pos = 0;
+    auto isSep = [](char c) { return c == ' ' || c == '\t' || c == ',' || c == '(' || c == ')' || c == '\r'; };
+    auto next = [&]() -> string_view {
+        while (pos < text.size() && isSep(text[pos])) pos++;
+        size_t start = pos;
+        while (pos < text.size() && !isSep(text[pos])) pos++;
+        return text.substr(start, pos - start);
+    };
+
+    p.name = next();
+    if (!isMnemonic(p.name)) return p; // a plain comment, not assembly
+
+    for (string_view tok = next(); !tok.empty(); tok = next()) {
+        if (p.numOps == 4 || !parseOperand(tok, p.ops[p.numOps])) return p;
+        p.numOps++;
+    }
+
+    // pseudo instructions the hand written programs use
+    if (sameName(p.name, "nop") && p.numOps == 0) {
+        p.name = "addi";
+        p.numOps = 3;
+    } else if (sameName(p.name, "j") && p.numOps == 1) {
+        p.name = "jal";
+        p.ops[1] = p.ops[0];
+        p.ops[0] = 0;
+        p.numOps = 2;
+    } else if (sameName(p.name, "mv") && p.numOps == 2) {
+        p.name = "addi";
+        p.ops[2] = 0;
+        p.numOps = 3;
+    } else if (sameName(p.name, "ret") && p.numOps == 0) {
+        p.name = "jalr";
+        p.ops[0] = 0;
+        p.ops[1] = 0;
+        p.ops[2] = 1;
+        p.numOps = 3;
+    }
+
+    p.ok = true;
+    return p;
+}
+
+bool Matches(const DecodedInstr &d, const ParsedAsm &recorded) {
+    if (!recorded.ok) return false;
+
+    if (sameName(recorded.name, ".word")) {
+        return recorded.numOps == 1 && (static_cast<uint64_t>(recorded.ops[0]) & 0xFFFFFFFFu) == d.word;
+    }
+    if (!d.valid || !sameName(recorded.name, d.name)) return false;
+
+    // expected operands in written order, and the bit width each one is compared at
+    int64_t expected[4];
+    int widths[4];
+    int n = 0;
+    auto push = [&](int64_t v, int w) { expected[n] = v; widths[n] = w; n++; };
+
+    switch (d.format) {
+        case 'R': push(d.rd, 5); push(d.rs1, 5); push(d.rs2, 5); break;
+        case 'I':
+            push(d.rd, 5);
+            push(d.rs1, 5);
+            push(d.imm, (sameName(d.name, "slli") || sameName(d.name, "srli") || sameName(d.name, "srai")) ? 5 : 12);
+            break;
+        case 'L': push(d.rd, 5); push(d.imm, 12); push(d.rs1, 5); break;
+        case 'S': push(d.rs2, 5); push(d.imm, 12); push(d.rs1, 5); break;
+        case 'B': push(d.rs1, 5); push(d.rs2, 5); push(d.imm, 13); break;
+        case 'U': push(d.rd, 5); push(d.imm, 20); break;
+        case 'J': push(d.rd, 5); push(d.imm, 21); break;
+        case 'Z': push(d.rd, 5); push(d.imm, 12); push(d.rs1, 5); break;
+        case 'Y':
+            if (sameName(d.name, "fence") && recorded.numOps == 2) {
+                push((d.word >> 24) & 0xF, 4);
+                push((d.word >> 20) & 0xF, 4);
+                break;
+            }
+            return recorded.numOps == 0;
+        default: return false;
+    }
+
+    if (recorded.numOps != n) return false;
+    for (int i = 0; i < n; ++i) {
+        uint64_t mask = (1ull << widths[i]) - 1;
+        if (((static_cast<uint64_t>(recorded.ops[i]) ^ static_cast<uint64_t>(expected[i])) & mask) != 0) return false;
+        // registers must match exactly, not just modulo 32
+        if (widths[i] == 5 && (recorded.ops[i] < 0 || recorded.ops[i] > 31)) return false;
+    }
+    return true;
+}
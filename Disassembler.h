@@ -0,0 +1,49 @@
+//
+// RV32I (plus Zicsr) decoder and disassembler. The assembly it prints follows the Generator's formatting,
+// so decoded words can be compared against the "// assembly" comments of TC files.
+//
+
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+using namespace std;
+
+
+struct DecodedInstr {
+    uint32_t word = 0;
+    const char *name = "unknown"; // mnemonic as the Generator writes it, "unknown" for illegal words
+    char format = '?';            // R, I, L (loads and jalr), S, B, U, J, Y (SYS), Z (Zicsr), '?' if illegal
+    int rd = 0;
+    int rs1 = 0;
+    int rs2 = 0;
+    int32_t imm = 0;              // sign extended immediate, shift amount for slli/srli/srai, CSR number for Zicsr
+    bool valid = false;
+};
+
+// Operands of an assembly line, as written in a TC file comment
+struct ParsedAsm {
+    string_view name;    // mnemonic, case preserved
+    int64_t ops[4] = {};  // registers by number, immediates by value, in written order
+    int numOps = 0;
+    bool ok = false;     // false if the text is not a recognisable instruction
+};
+
+DecodedInstr Decode(uint32_t word);
+// Inverse of Decode: writes rd, rs1, rs2 and imm back into d.word's opcode and function bits
+uint32_t Encode(const DecodedInstr &d);
+string Disassemble(uint32_t word);
+string FormatAssembly(const DecodedInstr &d); // ".word 0x..." for words that are not instructions
+
+// Parses "addi x1, x2, -3", "lw x1, 4(x2)" or "ECALL"; trailing "; note" text is ignored.
+// The pseudo instructions nop, j, mv and ret are expanded to their base instructions.
+ParsedAsm ParseAssembly(string_view text);
+
+// True if the recorded assembly describes the decoded instruction. Immediates are
+// compared modulo their field width, so hex and negative spellings both match.
+bool Matches(const DecodedInstr &d, const ParsedAsm &recorded);
+
+
+#endif //DISASSEMBLER_H
@@ -5,19 +5,58 @@
 #include "Generator.h"
 #include <iostream>
 #include <bitset>
+#include <tuple>
+#include <cstdio>
+#include "Assembler.h"
+#include "Disassembler.h"
+#include "Simulator.h"
 
 using namespace std;
 
 Generator::Generator(char type, int NumofInstructions, char Format)
-    : type(type), NumofInstructions(NumofInstructions), Format(Format) {
+    : type(type), NumofInstructions(NumofInstructions), Format(Format), outputName(1, Format) {
     std::random_device rd;
-    rng.seed(rd());
+    seed = rd();
+    rng.seed(seed);
 
 }
 
+void Generator::SetSeed(uint32_t newSeed) {
+    seed = newSeed;
+    rng.seed(seed);
+}
+
+void Generator::SetOutputName(const string &name) {
+    outputName = name;
+}
+
+string Generator::ConfigString() const {
+    // bump the version whenever the generation code changes what a seed produces
+    string config = "v2;type=" + string(1, type) + ";format=" + string(1, Format) +
+                    ";count=" + to_string(NumofInstructions) + ";seed=" + to_string(seed);
+    if (selfCheck) config += ";signature=" + to_string(signatureAddress);
+    return config;
+}
+
+void Generator::SetSelfCheck(uint32_t address) {
+    selfCheck = true;
+    signatureAddress = address;
+}
+
+int Generator::pickRd() {
+    std::uniform_int_distribution<int> regDist(0, selfCheck ? SELF_CHECK_BASE_REG - 1 : 31);
+    return regDist(rng);
+}
+
+int Generator::forwardTarget(int maxAhead) {
+    // anywhere up to the first epilogue instruction, so every run reaches the epilogue
+    std::uniform_int_distribution<int> ahead(1, max(1, min(maxAhead, bodySize - bodyIndex)));
+    return ahead(rng);
+}
+
 pair<string,string> Generator::generateR() {
     std::uniform_int_distribution<int> regDist(0, 31);
-    int rd = regDist(rng);
+    int rd = pickRd();
     int rs1 = regDist(rng);
     int rs2 = regDist(rng);
 
@@ -56,7 +95,7 @@ pair<string,string> Generator::generateR() {
 
 pair<string,string> Generator::generateI() {
     std::uniform_int_distribution<int> regDist(0, 31);
-    int rd = regDist(rng);
+    int rd = pickRd();
     int rs1 = regDist(rng);
     // signed 12-bit immediate: -2048..2047
     std::uniform_int_distribution<int> immDist(-2048, 2047);
@@ -79,10 +118,19 @@ pair<string,string> Generator::generateI() {
 
     std::uniform_int_distribution<int> pick(0, (int)I_TYPE.size() - 1);
     int id = pick(rng);
+    while (selfCheck && I_TYPE[id].second == "jalr") id = pick(rng); // its target depends on register values
     int funct3 = I_TYPE[id].first.first;
     string opcode = I_TYPE[id].first.second;
     string instr_name = I_TYPE[id].second;
 
+    if (selfCheck && opcode == "0000011") {
+        // aligned load from the self-check data region
+        int size = funct3 == 0b010 ? 4 : (funct3 & 0b011) == 0b001 ? 2 : 1;
+        std::uniform_int_distribution<int> slot(0, SELF_CHECK_DATA_BYTES / size - 1);
+        rs1 = SELF_CHECK_BASE_REG;
+        imm = slot(rng) * size;
+    }
+
     if (instr_name == "slli" || instr_name == "srli") {
         // shift amount is 0..31
         std::uniform_int_distribution<int> sh(0, 31);
@@ -136,6 +184,15 @@ pair<string,string> Generator::generateS() {
     int funct3 = S_TYPE[id].first;
     string instr_name = S_TYPE[id].second;
 
+    if (selfCheck) {
+        // aligned store into the self-check data region
+        int size = 1 << funct3;
+        std::uniform_int_distribution<int> slot(0, SELF_CHECK_DATA_BYTES / size - 1);
+        rs1 = SELF_CHECK_BASE_REG;
+        imm = slot(rng) * size;
+        imm12 = static_cast<uint32_t>(imm) & 0xFFFu;
+    }
+
     string imm_11_5 = bitset<7>((imm12 >> 5) & 0x7F).to_string();
     string imm_4_0 = bitset<5>(imm12 & 0x1F).to_string();
 
@@ -158,6 +215,7 @@ pair<string,string> Generator::generateB() {
     // branch offset is 13 bits (imm/2 typically); generate k in -2048..2047 then imm = k*2
     std::uniform_int_distribution<int> kDist(-2048, 2047);
     int k = kDist(rng);
+    if (selfCheck) k = forwardTarget(1023) * 2;
     int imm = k * 2;
     uint32_t imm13 = static_cast<uint32_t>(imm) & 0x1FFFu;
 
@@ -196,7 +254,7 @@ pair<string,string> Generator::generateB() {
 
 pair<string,string> Generator::generateU() {
     std::uniform_int_distribution<int> regDist(0, 31);
-    int rd = regDist(rng);
+    int rd = pickRd();
 
     //Generate immediate (-524288 to 524287)
 std::uniform_int_distribution<int> immDist(-524288, 524287);    int imm = immDist(rng);
@@ -218,11 +276,12 @@ std::uniform_int_distribution<int> immDist(-524288, 524287);    int imm = immDis
 }
 pair<string,string> Generator::generateJ() {
     std::uniform_int_distribution<int> regDist(0, 31);
-    int rd = regDist(rng);
+    int rd = pickRd();
 
     // Generate signed 20-bit immediate (range -524288 .. 524287)
     std::uniform_int_distribution<int> immDist(-524288, 524287);
     int imm = immDist(rng);
+    if (selfCheck) imm = forwardTarget(262143) * 2;
 
     // The immediate represents bits [20:1] of the offset (bit 0 is implicit 0)
     uint32_t offset = static_cast<uint32_t>(imm << 1); // Shift to get actual offset
@@ -255,7 +314,7 @@ pair<string,string> Generator::generateSYS() {
     string instr_name3 = "FENCE";
     string instr_binary3 = "00000011001100000000000000001111";
     string instr_name4 = "PAUSE";
-    string instr_binary4 = "00000011001100000000000000001111";
+    string instr_binary4 = "00000001000000000000000000001111"; // fence w,0
     string instr_name5 = "FENCE.TSO";
     string instr_binary5 = "10000011001100000000000000001111";
     vector <pair<string,string>> sys_instructions = {{instr_name1,intsr_binary1}, {instr_name2,instr_binary2},{ instr_name3,instr_binary3}, {instr_name4,instr_binary4}, {instr_name5,instr_binary5}};
@@ -266,6 +325,19 @@ pair<string,string> Generator::generateSYS() {
 return {selected_instr.second, selected_instr.first};
 }
 
+pair<string,string> Generator::GenerateOne(char format) {
+    switch (format) {
+        case 'R': return generateR();
+        case 'I': return generateI();
+        case 'S': return generateS();
+        case 'B': return generateB();
+        case 'U': return generateU();
+        case 'J': return generateJ();
+        case 'Y': return generateSYS();
+        default: return generateR();
+    }
+}
+
 void Generator::Start() {
 
     for (int i = 0; i < NumofInstructions; ++i) {
@@ -315,8 +387,10 @@ void Generator::GenerateMixedSet()
     vector<char> formats = {'R', 'I', 'S', 'B', 'U', 'J'};
     std::uniform_int_distribution<int> pick(0, (int)formats.size() - 1);
 
+    bodySize = NumofInstructions - 1;
     for (int i = 0; i < NumofInstructions-1; ++i)
     {
+        bodyIndex = i;
         char format = formats[pick(rng)];
         pair<string,string> instr;
         switch (format) {
@@ -335,7 +409,7 @@ void Generator::GenerateMixedSet()
     generatedInstructions.push_back(sysInstr);
 }
 
-void Generator::GenerateTCFiles() {
+void Generator::GenerateProgram() {
     switch(Format)
     {
         case 'R': GenerateAllRType(); break;
@@ -347,64 +421,283 @@ void Generator::GenerateTCFiles() {
             case 'M': GenerateMixedSet(); break;
             default: GenerateAllRType(); break;
     }
+    if (selfCheck) AddSelfCheck();
+}
 
-    string filename = "../TestCases/TC-" + string(1, Format) + ".txt";
-    ofstream ofs(filename);
+void Generator::AddSelfCheck() {
+    const int base = SELF_CHECK_BASE_REG;
+
+    // prologue: every register gets a known value and the data region starts out zeroed
+    Assembler prologue;
+    for (int r = 1; r < base; ++r) prologue.Li(r, rng());
+    prologue.Li(base, signatureAddress - SELF_CHECK_DATA_BYTES);
+    for (int offset = 0; offset < SELF_CHECK_DATA_BYTES; offset += 4) prologue.S("sw", 0, base, offset);
+
+    // epilogue: x1 = rotl(x1 ^ value, 5) over x2..x30, the data region and x31, then store x1
+    Assembler epilogue;
+    auto fold = [&](int value, int tmp) {
+        epilogue.R("xor", 1, 1, value);
+        epilogue.I("slli", tmp, 1, 5);
+        epilogue.I("srli", 1, 1, 27);
+        epilogue.R("or", 1, 1, tmp);
+    };
+    for (int r = 2; r < base; ++r) fold(r, r); // a register is free once it has been folded
+    for (int offset = 0; offset < SELF_CHECK_DATA_BYTES; offset += 4) {
+        epilogue.I("lw", 2, base, offset);
+        fold(2, 2);
+    }
+    fold(base, 2);
+    epilogue.S("sw", 1, base, SELF_CHECK_DATA_BYTES);
+
+    // the epilogue runs right before the final SYS instruction, or last if the program has none
+    auto &body = generatedInstructions;
+    bool endsWithSys = !body.empty() && Decode(static_cast<uint32_t>(stoul(body.back().first, nullptr, 2))).format == 'Y';
+    auto &pro = prologue.Program();
+    auto &epi = epilogue.Program();
+    body.insert(endsWithSys ? body.end() - 1 : body.end(), epi.begin(), epi.end());
+    body.insert(body.begin(), pro.begin(), pro.end());
+}
 
+bool Generator::ExpectedSignature(const uint32_t *words, size_t count, uint32_t &signature, string &error) const {
+    uint64_t codeStart = layout.baseAddress;
+    uint64_t codeEnd = codeStart + count * 4;
+    uint64_t dataStart = signatureAddress - SELF_CHECK_DATA_BYTES;
+    if (codeEnd > 0xFFFFFFFFull || (codeStart < signatureAddress + 4ull && dataStart < codeEnd)) {
+        error = "the program overlaps the self-check data region";
+        return false;
+    }
+
+    Simulator sim;
+    sim.LoadCode(static_cast<uint32_t>(codeStart), vector<uint32_t>(words, words + count));
+    if (!sim.Run(count * 16 + 1000000, error)) return false;
+    signature = sim.Read(signatureAddress, 4);
+    return true;
+}
+
+bool Generator::WriteSignatureFile(const uint32_t *words, size_t count) const {
+    uint32_t signature;
+    string error;
+    if (!ExpectedSignature(words, count, signature, error)) {
+        // a self-checking program without its signature is useless, drop any earlier output too
+        cout << "Self-check signature not computed: " << error << ", no files written" << endl;
+        remove(("../TestCases/SIG-" + outputName + ".txt").c_str());
+        remove(("../TestCases/TC-" + outputName + ".txt").c_str());
+        remove(("../MemData/Mem-" + outputName + ".txt").c_str());
+        return false;
+    }
+
+    string filename = "../TestCases/SIG-" + outputName + ".txt";
+    ofstream ofs(filename);
     if (ofs.is_open()) {
         cout << "Opened " << filename << endl;
     }
 
-    int byteAddr = 0;  //for mem address
-    for (int i = 0; i < generatedInstructions.size(); ++i) {
-        string instruction = generatedInstructions[i].first;
-        string assembly = generatedInstructions[i].second;
+    char line[64];
+    snprintf(line, sizeof(line), "sig[0x%08x] = 32'h%08x;", signatureAddress, signature);
+    ofs << "// expected signature of TC-" << outputName << ".txt, stored by its epilogue" << '\n';
+    ofs << line << '\n';
+    cout << line << endl;
+    return true;
+}
+
+void Generator::LoadProgram(vector<pair<string,string>> program) {
+    generatedInstructions = std::move(program);
+}
+
+bool Generator::GenerateTCFiles() {
+    GenerateProgram();
+    return WriteTCFiles();
+}
+
+vector<uint32_t> Generator::Words() const {
+    vector<uint32_t> words;
+    words.reserve(generatedInstructions.size());
+    for (auto &instr : generatedInstructions) words.push_back(static_cast<uint32_t>(stoul(instr.first, nullptr, 2)));
+    return words;
+}
+
+bool Generator::WriteTCFiles() {
+    vector<uint32_t> words = Words();
+    if (selfCheck && !WriteSignatureFile(words.data(), words.size())) return false;
+    WriteTC(words.data(), words.size(), [this](size_t i) { return generatedInstructions[i].second; });
+    return true;
+}
+
+bool Generator::WriteWords(const uint32_t *words, size_t count, const unordered_map<size_t, string> &texts) {
+    if (selfCheck && !WriteSignatureFile(words, count)) return false;
+    WriteTC(words, count, [&](size_t i) {
+        auto it = texts.find(i);
+        return it != texts.end() ? it->second : Disassemble(words[i]);
+    });
+    WriteMem(words, count);
+    return true;
+}
+
+namespace {
+    // output is formatted into a buffer and written in large blocks
+    const size_t FLUSH_BYTES = 1 << 20;
+
+    void flushIfFull(ofstream &ofs, string &out) {
+        if (out.size() < FLUSH_BYTES) return;
+        ofs.write(out.data(), static_cast<streamsize>(out.size()));
+        out.clear();
+    }
+}
+
+void Generator::WriteTC(const uint32_t *words, size_t count, const function<string(size_t)> &assembly) const {
+    string filename = "../TestCases/TC-" + outputName + ".txt";
+    ofstream ofs(filename);
 
-        // Split 32-bit instruction into 4 bytes
+    if (ofs.is_open()) {
+        cout << "Opened " << filename << endl;
+    }
 
-        string byte0 = instruction.substr(24, 8);  // bits [7:0]
-        string byte1 = instruction.substr(16, 8);  // bits [15:8]
-        string byte2 = instruction.substr(8, 8);   // bits [23:16]
-        string byte3 = instruction.substr(0, 8);   // bits [31:24]
+    size_t wordBytes = layout.WordBytes();
+    size_t numWords = (count * 4 + wordBytes - 1) / wordBytes;
+    string out;
+    out.reserve(FLUSH_BYTES + 4096);
+    string width = to_string(layout.wordBits) + "'b";
+
+    // fixed records: every address has as many digits as the last one
+    int digits = 0;
+    if (layout.fixedRecords) {
+        digits = numWords == 0 ? 1 : static_cast<int>(to_string(WordAddress(numWords - 1)).size());
+        out += "// fixed-record layout width=" + to_string(layout.wordBits) +
+               " endian=" + (layout.bigEndian ? "big" : "little") +
+               " addressing=" + (layout.wordAddressed ? "word" : "byte") +
+               " base=" + to_string(layout.baseAddress) + " slot=" + to_string(MemLayout::ASM_SLOT) +
+               " instructions=" + to_string(count) + '\n';
+    }
 
-        // Output bytes in little-endian order with memory addresses
-        ofs << "mem[" << byteAddr++ << "] = 8'b" << byte0 << "; // " << assembly << " [byte 1]" << endl;
-        ofs << "mem[" << byteAddr++ << "] = 8'b" << byte1 << "; // " << " [byte 2]" << endl;
-        ofs << "mem[" << byteAddr++ << "] = 8'b" << byte2 << "; // " << " [byte 3]" << endl;
-        ofs << "mem[" << byteAddr++ << "] = 8'b" << byte3 << "; // " << " [byte 4]" << endl;
+    if (wordBytes < 4) {
+        // Each instruction spans several lines, tag them like the byte-addressable files do
+        string unit = wordBytes == 1 ? " [byte " : " [half ";
+        size_t unitsPerInstr = 4 / wordBytes;
+        for (size_t w = 0; w < numWords; ++w) {
+            size_t part = w % unitsPerInstr;
+            out += "mem[";
+            AppendAddress(out, w, digits);
+            out += "] = ";
+            out += width;
+            AppendWordBits(out, words, count, w);
+            out += "; // ";
+            AppendAsmSlot(out, part == 0 ? assembly(w / unitsPerInstr) : string());
+            out += unit;
+            out += static_cast<char>('1' + part);
+            out += "]\n";
+            flushIfFull(ofs, out);
+        }
+    } else {
+        // One or more whole instructions per line, list every instruction held by the word.
+        // Fixed records keep a slot for the padding after the last instruction too.
+        size_t instrPerWord = wordBytes / 4;
+        for (size_t w = 0; w < numWords; ++w) {
+            out += "mem[";
+            AppendAddress(out, w, digits);
+            out += "] = ";
+            out += width;
+            AppendWordBits(out, words, count, w);
+            out += "; // ";
+            for (size_t k = 0; k < instrPerWord; ++k) {
+                size_t i = w * instrPerWord + k;
+                if (i >= count && !layout.fixedRecords) break;
+                if (k > 0) out += " | ";
+                AppendAsmSlot(out, i < count ? assembly(i) : string());
+            }
+            out += '\n';
+            flushIfFull(ofs, out);
+        }
     }
 
+    ofs.write(out.data(), static_cast<streamsize>(out.size()));
     ofs.close();
 
 }
 
 
 void Generator::GenerateMem() {
-    string filename = "../MemData/Mem-" + string(1, Format) + ".txt";
+    vector<uint32_t> words = Words();
+    WriteMem(words.data(), words.size());
+}
+
+void Generator::WriteMem(const uint32_t *words, size_t count) const {
+    string filename = "../MemData/Mem-" + outputName + ".txt";
     ofstream ofs(filename);
 
     if (ofs.is_open()) {
         cout << "Opened " << filename << endl;
     }
 
-    for (int i = 0; i < generatedInstructions.size(); ++i) {
-        string instruction = generatedInstructions[i].first;
+    size_t wordBytes = layout.WordBytes();
+    size_t numWords = (count * 4 + wordBytes - 1) / wordBytes;
+    string out;
+    out.reserve(FLUSH_BYTES + 256);
 
-        // Split 32-bit instruction into 4 bytes using little endian
+    for (size_t w = 0; w < numWords; ++w) {
+        AppendWordBits(out, words, count, w);
+        out += '\n';
+        flushIfFull(ofs, out);
+    }
+    ofs.write(out.data(), static_cast<streamsize>(out.size()));
+    ofs.close();
 
-        string byte0 = instruction.substr(24, 8);  // bits [7:0]
-        string byte1 = instruction.substr(16, 8);  // bits [15:8]
-        string byte2 = instruction.substr(8, 8);   // bits [23:16]
-        string byte3 = instruction.substr(0, 8);   // bits [31:24]
+}
 
-        //Output bytes
-        ofs << byte0 << endl;
-        ofs << byte1 << endl;
-        ofs << byte2 << endl;
-        ofs << byte3 << endl;
+
+bool MemLayout::Valid(string &why) const {
+    if (wordBits != 8 && wordBits != 16 && wordBits != 32 && wordBits != 64 && wordBits != 128) {
+        why = "word width must be 8, 16, 32, 64 or 128 bits";
+        return false;
     }
-    ofs.close();
+    if (baseAddress % WordBytes() != 0) {
+        why = "base address must be aligned to the word width";
+        return false;
+    }
+    return true;
+}
 
+void Generator::SetMemLayout(const MemLayout &memLayout) {
+    layout = memLayout;
+}
+
+void Generator::AppendWordBits(string &out, const uint32_t *words, size_t count, size_t word) const {
+    size_t wordBytes = layout.WordBytes();
+    size_t at = out.size();
+    out.resize(at + wordBytes * 8);
+    for (size_t b = 0; b < wordBytes; ++b) {
+        // most significant byte first: the highest address for little endian, the lowest for big endian
+        size_t offset = word * wordBytes + (layout.bigEndian ? b : wordBytes - 1 - b);
+        uint8_t value = 0; // padding after the last instruction
+        if (offset / 4 < count) {
+            // little endian puts bits [7:0] at the lowest address, big endian puts bits [31:24] there
+            size_t k = offset % 4;
+            value = static_cast<uint8_t>(words[offset / 4] >> (layout.bigEndian ? (3 - k) * 8 : k * 8));
+        }
+        for (int bit = 0; bit < 8; ++bit) out[at + b * 8 + bit] = static_cast<char>('0' + ((value >> (7 - bit)) & 1));
+    }
+}
+
+void Generator::AppendAddress(string &out, size_t word, int digits) const {
+    char text[24];
+    int length = snprintf(text, sizeof(text), "%0*llu", digits, static_cast<unsigned long long>(WordAddress(word)));
+    out.append(text, static_cast<size_t>(length));
+}
+
+void Generator::AppendAsmSlot(string &out, const string &assembly) const {
+    if (!layout.fixedRecords) {
+        out += assembly;
+        return;
+    }
+    size_t length = min(assembly.size(), static_cast<size_t>(MemLayout::ASM_SLOT));
+    out.append(assembly, 0, length);
+    out.append(MemLayout::ASM_SLOT - length, ' ');
+}
+
+uint64_t Generator::WordAddress(size_t word) const {
+    if (layout.wordAddressed) {
+        return layout.baseAddress / layout.WordBytes() + word;
+    }
+    return layout.baseAddress + word * layout.WordBytes();
 }
 
 
@@ -9,9 +9,27 @@
 #include <random>
 #include <vector>
 #include <fstream>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
 
 using namespace std;
 
+// How the instruction image is laid out in the TC and Mem output files.
+// The defaults reproduce the original byte-addressable, little-endian output.
+struct MemLayout {
+    int wordBits = 8;           // width of one memory line: 8, 16, 32, 64 or 128
+    bool bigEndian = false;     // byte order of the image
+    bool wordAddressed = false; // mem[] index counts words instead of bytes
+    uint64_t baseAddress = 0;   // byte address of the first instruction
+    bool fixedRecords = false;  // pad every TC line to the same length so it can be patched in place
+
+    static const int ASM_SLOT = 32; // characters reserved per instruction's assembly in fixed records
+
+    int WordBytes() const { return wordBits / 8; }
+    bool Valid(string &why) const;
+};
+
 
 class Generator {
 private:
@@ -21,6 +39,19 @@ private:
 vector <pair<string,string>> generatedInstructions; //to store generated instructions for test case files/
     // random number generator thats better than rand() and we can use it to get negatives
     std::mt19937 rng;
+    uint32_t seed;
+    MemLayout layout;
+    string outputName; // TC-<name>.txt / Mem-<name>.txt, the format letter by default
+
+    // Self-checking mode: loads and stores go through x31 into the SELF_CHECK_DATA_BYTES bytes
+    // below signatureAddress, branches and jumps only go forward inside the body, and an epilogue
+    // folds x1..x31 and that data region into one word stored at signatureAddress.
+    bool selfCheck = false;
+    uint32_t signatureAddress = 0;
+    int bodyIndex = 0; // position of the instruction being generated, for forward branch targets
+    int bodySize = 0;
+    static const int SELF_CHECK_BASE_REG = 31;
+    static const int SELF_CHECK_DATA_BYTES = 256;
 
     pair<string,string> generateR();
     pair<string,string> generateI();
@@ -29,14 +60,45 @@ vector <pair<string,string>> generatedInstructions; //to store generated instruc
     pair<string,string> generateU();
     pair<string,string> generateJ();
     pair<string,string>generateSYS();
+    int pickRd(); // destination register, never the self-check base register
+    int forwardTarget(int maxAhead); // instructions to skip for a self-check branch or jump
+
+    void AddSelfCheck(); // wrap generatedInstructions in the self-check prologue and epilogue
+    bool ExpectedSignature(const uint32_t *words, size_t count, uint32_t &signature, string &error) const;
+    bool WriteSignatureFile(const uint32_t *words, size_t count) const; // false, with no output files left, on failure
+
+    // TC and Mem writers over packed instruction words; assembly(i) gives instruction i's comment
+    void WriteTC(const uint32_t *words, size_t count, const function<string(size_t)> &assembly) const;
+    void WriteMem(const uint32_t *words, size_t count) const;
+    // appends memory word `word` of the image, most significant bit first; the last word is zero padded
+    void AppendWordBits(string &out, const uint32_t *words, size_t count, size_t word) const;
+    uint64_t WordAddress(size_t word) const;
+    void AppendAddress(string &out, size_t word, int digits) const;   // zero padded to digits in fixed records
+    void AppendAsmSlot(string &out, const string &assembly) const;   // padded to ASM_SLOT in fixed records
 
 
 
 public:
     Generator(char type, int NumofInstructions, char Format);
+    void SetMemLayout(const MemLayout &memLayout);
+    void SetSeed(uint32_t newSeed);
+    void SetOutputName(const string &name);
+    void SetSelfCheck(uint32_t address); // generate self-checking programs storing their signature at address
+    pair<string,string> GenerateOne(char format); // one random instruction of format R, I, S, B, U, J or Y
+    string ConfigString() const; // everything that determines the generated program, used as the cache key
     void Start();
     void StartMixed();
-    void GenerateTCFiles();
+    void GenerateProgram(); // fill generatedInstructions for the selected format
+    void LoadProgram(vector<pair<string,string>> program); // use an existing program instead of generating one
+    const vector<pair<string,string>> &Program() const { return generatedInstructions; }
+    vector<uint32_t> Words() const; // the program as packed instruction words
+    // Writes TC and Mem files straight from packed words, e.g. a mapped cache entry; the assembly is
+    // the disassembly except where texts holds the text recorded for an instruction index
+    bool WriteWords(const uint32_t *words, size_t count, const unordered_map<size_t, string> &texts);
+    // The writers return false, and leave no TC, Mem or SIG file behind, if a self-checking
+    // program's signature cannot be computed
+    bool GenerateTCFiles();
+    bool WriteTCFiles(); // write the current program without regenerating it
     void GenerateMem(); //for vivado
     void GenerateMixedSet(); // to make consistent output for Mem and TCFiles.
     void GenerateAllJType();
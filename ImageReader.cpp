@@ -0,0 +1,300 @@
+//
+// Zero-copy reader for TC and Mem files. The mapped text is scanned in parallel chunks and
+// turned back into 32-bit instruction words plus the assembly recorded next to them.
+//
+
+#include "ImageReader.h"
+
+using namespace std;
+
+namespace {
+    enum LineKind { BLANK, DATA, COMMENT, BAD };
+
+    struct Line {
+        LineKind kind = BLANK;
+        uint64_t hi = 0, lo = 0; // value of a data line, up to 128 bits
+        int width = 0;
+        string_view comment;     // inline comment of a data line, or the text of a standalone comment
+    };
+
+    // what the first pass learns about a chunk
+    struct ChunkInfo {
+        size_t begin = 0, end = 0;
+        size_t units = 0;        // data lines
+        int width = 0;           // width of the first data line
+        bool mixedWidths = false;
+        bool bad = false;
+        size_t badOffset = 0;
+        bool hasTrailing = false; // standalone comment after the last data line
+        string_view trailing;
+    };
+
+    bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    string_view trim(string_view s) {
+        while (!s.empty() && isSpace(s.front())) s.remove_prefix(1);
+        while (!s.empty() && isSpace(s.back())) s.remove_suffix(1);
+        return s;
+    }
+
+    void shiftIn(Line &line, int bits, uint64_t value) {
+        line.hi = (line.hi << bits) | (line.lo >> (64 - bits));
+        line.lo = (line.lo << bits) | value;
+    }
+
+    // "addi x1, x2, 3 [byte 1]" -> "addi x1, x2, 3", "[byte 2]" -> ""
+    string_view stripPartTag(string_view comment) {
+        if (!comment.empty() && comment.back() == ']') {
+            size_t open = comment.rfind('[');
+            if (open != string_view::npos) {
+                string_view tag = comment.substr(open);
+                if (tag.substr(0, 6) == "[byte " || tag.substr(0, 6) == "[half ") {
+                    return trim(comment.substr(0, open));
+                }
+            }
+        }
+        return comment;
+    }
+
+    // mem[12] = 8'b00010011; // addi x2, x0, 3 [byte 1]
+    Line scanTCLine(string_view s) {
+        Line line;
+        s = trim(s);
+        if (s.empty()) return line;
+        if (s.substr(0, 2) == "//") {
+            line.kind = COMMENT;
+            line.comment = trim(s.substr(2));
+            return line;
+        }
+
+        line.kind = BAD;
+        if (s.substr(0, 4) != "mem[") return line;
+        size_t p = s.find(']');
+        if (p == string_view::npos) return line;
+        p = s.find('=', p);
+        if (p == string_view::npos) return line;
+        p++;
+        while (p < s.size() && isSpace(s[p])) p++;
+
+        int width = 0;
+        while (p < s.size() && s[p] >= '0' && s[p] <= '9') width = width * 10 + (s[p++] - '0');
+        if (p + 1 >= s.size() || s[p] != '\'') return line;
+        char base = static_cast<char>(s[p + 1] | 0x20);
+        p += 2;
+
+        int digits = 0;
+        for (; p < s.size() && s[p] != ';' && !isSpace(s[p]) && s[p] != '/'; ++p) {
+            char c = s[p];
+            if (c == '_') continue;
+            if (base == 'b' && (c == '0' || c == '1')) {
+                shiftIn(line, 1, static_cast<uint64_t>(c - '0'));
+            } else if (base == 'h' && c >= '0' && c <= '9') {
+                shiftIn(line, 4, static_cast<uint64_t>(c - '0'));
+            } else if (base == 'h' && (c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+                shiftIn(line, 4, static_cast<uint64_t>((c | 0x20) - 'a' + 10));
+            } else {
+                return line;
+            }
+            digits++;
+        }
+        if (digits == 0 || width == 0) return line;
+
+        size_t c = s.find("//", p);
+        if (c != string_view::npos) line.comment = stripPartTag(trim(s.substr(c + 2)));
+        line.width = width;
+        line.kind = DATA;
+        return line;
+    }
+
+    // 00010011
+    Line scanMemLine(string_view s) {
+        Line line;
+        s = trim(s);
+        if (s.empty() || s[0] == '@') return line; // $readmem address markers are not data
+        if (s.substr(0, 2) == "//") {
+            line.kind = COMMENT;
+            line.comment = trim(s.substr(2));
+            return line;
+        }
+
+        line.kind = BAD;
+        int width = 0;
+        for (char c : s) {
+            if (c == '_') continue;
+            if (c != '0' && c != '1') return line;
+            shiftIn(line, 1, static_cast<uint64_t>(c - '0'));
+            width++;
+        }
+        line.width = width;
+        line.kind = DATA;
+        return line;
+    }
+
+    // calls visit(line, offset) for every line of data[begin, end)
+    template <class Visit>
+    void forEachLine(string_view data, size_t begin, size_t end, bool isTC, Visit visit) {
+        size_t pos = begin;
+        while (pos < end) {
+            size_t nl = data.find('\n', pos);
+            if (nl == string_view::npos || nl > end) nl = end;
+            string_view text = data.substr(pos, nl - pos);
+            visit(isTC ? scanTCLine(text) : scanMemLine(text), pos);
+            pos = nl + 1;
+        }
+    }
+}
+
+unsigned ResolveThreads(unsigned threads) {
+    if (threads == 0) threads = thread::hardware_concurrency();
+    return max(threads, 1u);
+}
+
+bool ReadImage(const MappedFile &file, bool bigEndian, unsigned threads, ParsedImage &image, string &error) {
+    string_view data = file.View();
+    image = ParsedImage();
+
+    // the first line with content tells the two file kinds apart
+    for (size_t pos = 0; pos < data.size();) {
+        size_t nl = data.find('\n', pos);
+        if (nl == string_view::npos) nl = data.size();
+        string_view line = trim(data.substr(pos, nl - pos));
+        if (!line.empty() && line.substr(0, 2) != "//") {
+            image.isTC = line.substr(0, 4) == "mem[";
+            break;
+        }
+        pos = nl + 1;
+    }
+
+    // split at line boundaries, a few chunks per thread to even out the load
+    size_t numChunks = max<size_t>(1, min<size_t>(ResolveThreads(threads) * 4, data.size() / 4096 + 1));
+    vector<ChunkInfo> chunks(numChunks);
+    size_t prev = 0;
+    for (size_t k = 0; k < numChunks; ++k) {
+        size_t end = data.size() * (k + 1) / numChunks;
+        if (k + 1 < numChunks) {
+            size_t nl = data.find('\n', max(end, prev));
+            end = nl == string_view::npos ? data.size() : nl + 1;
+        } else {
+            end = data.size();
+        }
+        chunks[k].begin = prev;
+        chunks[k].end = max(end, prev);
+        prev = chunks[k].end;
+    }
+
+    // pass 1: count data lines so every chunk knows where its units land
+    ParallelFor(numChunks, threads, [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; ++k) {
+            ChunkInfo &c = chunks[k];
+            forEachLine(data, c.begin, c.end, image.isTC, [&](const Line &line, size_t offset) {
+                if (line.kind == DATA) {
+                    if (c.units == 0) c.width = line.width;
+                    else if (line.width != c.width) c.mixedWidths = true;
+                    c.units++;
+                    c.hasTrailing = false;
+                } else if (line.kind == COMMENT) {
+                    c.hasTrailing = true;
+                    c.trailing = line.comment;
+                } else if (line.kind == BAD && !c.bad) {
+                    c.bad = true;
+                    c.badOffset = offset;
+                }
+            });
+        }
+    });
+
+    vector<size_t> unitStart(numChunks);
+    vector<string_view> pendingAtStart(numChunks);
+    size_t units = 0;
+    string_view pending;
+    for (size_t k = 0; k < numChunks; ++k) {
+        ChunkInfo &c = chunks[k];
+        if (c.bad) {
+            error = "unrecognised line at byte offset " + to_string(c.badOffset);
+            return false;
+        }
+        if (c.units > 0) {
+            if (image.wordBits == 0) image.wordBits = c.width;
+            if (c.mixedWidths || c.width != image.wordBits) {
+                error = "lines of different widths in one file";
+                return false;
+            }
+        }
+        unitStart[k] = units;
+        pendingAtStart[k] = pending;
+        units += c.units;
+        if (c.hasTrailing) pending = c.trailing;
+        else if (c.units > 0) pending = {};
+    }
+
+    if (units == 0) {
+        error = "no memory lines found";
+        return false;
+    }
+    if (image.wordBits % 8 != 0 || image.wordBits > 128) {
+        error = "unsupported word width " + to_string(image.wordBits);
+        return false;
+    }
+
+    size_t wordBytes = image.wordBits / 8;
+    size_t numInstr = units * wordBytes / 4; // a trailing partial instruction is dropped
+    vector<uint8_t> bytes(units * wordBytes);
+    image.words.resize(numInstr);
+    image.assembly.resize(numInstr);
+
+    // pass 2: place every unit's bytes and pick up the assembly comments
+    ParallelFor(numChunks, threads, [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; ++k) {
+            size_t u = unitStart[k];
+            string_view pendingComment = pendingAtStart[k];
+            forEachLine(data, chunks[k].begin, chunks[k].end, image.isTC, [&](const Line &line, size_t) {
+                if (line.kind == COMMENT) {
+                    pendingComment = line.comment;
+                    return;
+                }
+                if (line.kind != DATA) return;
+
+                for (size_t b = 0; b < wordBytes; ++b) {
+                    // byte b of the line's value counted from the least significant end
+                    size_t shift = b * 8;
+                    uint8_t v = static_cast<uint8_t>(shift < 64 ? line.lo >> shift : line.hi >> (shift - 64));
+                    size_t addr = bigEndian ? wordBytes - 1 - b : b;
+                    bytes[u * wordBytes + addr] = v;
+                }
+
+                if (wordBytes < 4) {
+                    size_t perInstr = 4 / wordBytes;
+                    size_t i = u / perInstr;
+                    if (u % perInstr == 0 && i < numInstr) {
+                        image.assembly[i] = !line.comment.empty() ? line.comment : pendingComment;
+                    }
+                } else {
+                    // wide words list their instructions separated by '|'
+                    size_t perWord = wordBytes / 4;
+                    string_view rest = line.comment;
+                    for (size_t j = 0; j < perWord; ++j) {
+                        size_t bar = rest.find('|');
+                        string_view part = trim(rest.substr(0, bar));
+                        if (j == 0 && part.empty()) part = pendingComment;
+                        image.assembly[u * perWord + j] = part;
+                        rest = bar == string_view::npos ? string_view() : rest.substr(bar + 1);
+                    }
+                }
+                pendingComment = {};
+                u++;
+            });
+        }
+    });
+
+    // pass 3: assemble the instruction words in memory order
+    ParallelFor(numInstr, threads, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const uint8_t *p = &bytes[i * 4];
+            image.words[i] = bigEndian
+                ? uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3]
+                : uint32_t(p[3]) << 24 | uint32_t(p[2]) << 16 | uint32_t(p[1]) << 8 | p[0];
+        }
+    });
+
+    return true;
+}
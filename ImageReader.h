@@ -0,0 +1,49 @@
+//
+// Zero-copy reader for TC and Mem files. The mapped text is scanned in parallel chunks and
+// turned back into 32-bit instruction words plus the assembly recorded next to them.
+//
+
+#ifndef IMAGEREADER_H
+#define IMAGEREADER_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+#include "MappedFile.h"
+
+using namespace std;
+
+
+struct ParsedImage {
+    int wordBits = 0;             // width of one memory line
+    bool isTC = false;            // TC file (mem[n] = ...) rather than a Mem file (bare bit strings)
+    vector<uint32_t> words;       // instructions in memory order
+    vector<string_view> assembly; // recorded assembly per instruction, empty if none; views into the mapped file
+};
+
+// Reads a TC or Mem file in any of the MemLayout word widths. Line order is memory order and
+// bigEndian must match the layout the file was written with. An instruction's assembly is the
+// comment on its first line, or the standalone "// ..." comment right above it.
+bool ReadImage(const MappedFile &file, bool bigEndian, unsigned threads, ParsedImage &image, string &error);
+
+unsigned ResolveThreads(unsigned threads); // 0 = one per hardware thread
+
+// Runs body(begin, end) over [0, count) split into one contiguous range per thread
+template <class Body>
+void ParallelFor(size_t count, unsigned threads, Body body) {
+    size_t n = min<size_t>(ResolveThreads(threads), max<size_t>(count, 1));
+    if (n <= 1) {
+        body(size_t(0), count);
+        return;
+    }
+    vector<thread> pool;
+    for (size_t t = 0; t < n; ++t) {
+        pool.emplace_back(body, count * t / n, count * (t + 1) / n);
+    }
+    for (auto &th : pool) th.join();
+}
+
+
+#endif //IMAGEREADER_H
@@ -0,0 +1,375 @@
+//
+// Library of parameterised RV32I benchmark kernels with their own initialised data section.
+//
+
+#include "Kernels.h"
+#include "Assembler.h"
+#include <random>
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+
+namespace {
+    const int MAX_UNROLL = 64;
+    const uint32_t ECALL = 0x00000073;
+
+    // hands out consecutive registers starting at the window base, never x0
+    class RegWindow {
+    private:
+        int base;
+        int taken = 0;
+
+    public:
+        explicit RegWindow(int base) : base(base) {}
+        int Take() {
+            int r = (base - 1 + taken) % 31 + 1;
+            taken++;
+            return r;
+        }
+        bool Overflow() const { return taken > 31; }
+    };
+
+    // count elements processed `unroll` at a time by a counted loop, the remainder straight-line after it.
+    // block(n, tag) emits n consecutive elements, tag makes its labels unique; advance(n) moves the pointers.
+    template <class Block, class Advance>
+    void unrolledLoop(Assembler &a, const string &label, int count, int unroll, int counter, Block block, Advance advance) {
+        int iterations = count / unroll;
+        if (iterations > 0) {
+            a.Li(counter, static_cast<uint32_t>(iterations));
+            a.Label(label);
+            block(unroll, label + "_");
+            advance(unroll);
+            a.I("addi", counter, counter, -1);
+            a.B("bne", counter, 0, label);
+        }
+        if (count % unroll > 0) block(count % unroll, label + "_tail");
+    }
+
+    // p = x * y by shift and add, RV32I has no multiply; clobbers x, y and t, returns through link
+    void emitMul(Assembler &a, int x, int y, int p, int t, int link) {
+        a.Label("mul");
+        a.I("addi", p, 0, 0);
+        a.Label("mul_loop");
+        a.B("beq", y, 0, "mul_done");
+        a.I("andi", t, y, 1);
+        a.B("beq", t, 0, "mul_skip");
+        a.R("add", p, p, x);
+        a.Label("mul_skip");
+        a.I("slli", x, x, 1);
+        a.I("srli", y, y, 1);
+        a.J(0, "mul_loop");
+        a.Label("mul_done");
+        a.I("jalr", 0, link, 0);
+    }
+
+    void emitWords(Assembler &a, const string &label, const vector<uint32_t> &words) {
+        a.Label(label);
+        for (uint32_t w : words) a.Word(w);
+    }
+
+    vector<uint32_t> randomWords(std::mt19937 &rng, int count, uint32_t limit) {
+        vector<uint32_t> words(count);
+        for (auto &w : words) w = limit == 0 ? rng() : rng() % limit;
+        return words;
+    }
+
+    void buildMemcpy(Assembler &a, RegWindow &regs, const KernelParams &p, std::mt19937 &rng) {
+        int src = regs.Take(), dst = regs.Take(), cnt = regs.Take();
+        vector<int> temps;
+        for (int i = 0; i < min(p.unroll, 8); ++i) temps.push_back(regs.Take());
+
+        a.La(src, "src");
+        a.La(dst, "dst");
+        unrolledLoop(a, "copy", p.size, p.unroll, cnt,
+            [&](int n, const string &) {
+                // a group of loads before its stores so the loads can overlap
+                for (int g = 0; g < n; g += static_cast<int>(temps.size())) {
+                    int end = min(n, g + static_cast<int>(temps.size()));
+                    for (int u = g; u < end; ++u) a.I("lw", temps[u - g], src, 4 * u);
+                    for (int u = g; u < end; ++u) a.S("sw", temps[u - g], dst, 4 * u);
+                }
+            },
+            [&](int n) {
+                a.I("addi", src, src, 4 * n);
+                a.I("addi", dst, dst, 4 * n);
+            });
+        a.Emit(ECALL);
+
+        emitWords(a, "src", randomWords(rng, p.size, 0));
+        emitWords(a, "dst", vector<uint32_t>(p.size, 0));
+    }
+
+    void buildDot(Assembler &a, RegWindow &regs, const KernelParams &p, std::mt19937 &rng) {
+        int pa = regs.Take(), pb = regs.Take(), cnt = regs.Take(), sum = regs.Take();
+        int x = regs.Take(), y = regs.Take(), prod = regs.Take(), t = regs.Take(), link = regs.Take();
+
+        a.La(pa, "a");
+        a.La(pb, "b");
+        a.I("addi", sum, 0, 0);
+        unrolledLoop(a, "dot", p.size, p.unroll, cnt,
+            [&](int n, const string &) {
+                for (int u = 0; u < n; ++u) {
+                    a.I("lw", x, pa, 4 * u);
+                    a.I("lw", y, pb, 4 * u);
+                    a.J(link, "mul");
+                    a.R("add", sum, sum, prod);
+                }
+            },
+            [&](int n) {
+                a.I("addi", pa, pa, 4 * n);
+                a.I("addi", pb, pb, 4 * n);
+            });
+        a.La(t, "result");
+        a.S("sw", sum, t, 0);
+        a.Emit(ECALL);
+        emitMul(a, x, y, prod, t, link);
+
+        emitWords(a, "a", randomWords(rng, p.size, 256));
+        emitWords(a, "b", randomWords(rng, p.size, 256));
+        emitWords(a, "result", {0});
+    }
+
+    void buildBubble(Assembler &a, RegWindow &regs, const KernelParams &p, std::mt19937 &rng) {
+        int base = regs.Take(), i = regs.Take(), j = regs.Take(), ptr = regs.Take();
+        int va = regs.Take(), vb = regs.Take();
+
+        if (p.size >= 2) {
+            // n-1 full passes over n-1 neighbouring pairs
+            a.La(base, "arr");
+            a.Li(i, static_cast<uint32_t>(p.size - 1));
+            a.Label("pass");
+            a.I("addi", ptr, base, 0);
+            unrolledLoop(a, "pairs", p.size - 1, p.unroll, j,
+                [&](int n, const string &tag) {
+                    for (int u = 0; u < n; ++u) {
+                        string keep = tag + to_string(u);
+                        a.I("lw", va, ptr, 4 * u);
+                        a.I("lw", vb, ptr, 4 * u + 4);
+                        a.B("bge", vb, va, keep);
+                        a.S("sw", vb, ptr, 4 * u);
+                        a.S("sw", va, ptr, 4 * u + 4);
+                        a.Label(keep);
+                    }
+                },
+                [&](int n) { a.I("addi", ptr, ptr, 4 * n); });
+            a.I("addi", i, i, -1);
+            a.B("bne", i, 0, "pass");
+        }
+        a.Emit(ECALL);
+
+        emitWords(a, "arr", randomWords(rng, p.size, 0));
+    }
+
+    void buildInsertion(Assembler &a, RegWindow &regs, const KernelParams &p, std::mt19937 &rng) {
+        int base = regs.Take(), pi = regs.Take(), end = regs.Take(), key = regs.Take();
+        int pj = regs.Take(), v = regs.Take();
+
+        a.La(base, "arr");
+        a.I("addi", pi, base, 4);
+        a.Li(end, static_cast<uint32_t>(4 * p.size));
+        a.R("add", end, base, end);
+        a.Label("outer");
+        a.B("bgeu", pi, end, "done");
+        a.I("lw", key, pi, 0);
+        a.I("addi", pj, pi, -4);
+        a.Label("shift");
+        a.B("bltu", pj, base, "place");
+        a.I("lw", v, pj, 0);
+        a.B("bge", key, v, "place");
+        a.S("sw", v, pj, 4);
+        a.I("addi", pj, pj, -4);
+        a.J(0, "shift");
+        a.Label("place");
+        a.S("sw", key, pj, 4);
+        a.I("addi", pi, pi, 4);
+        a.J(0, "outer");
+        a.Label("done");
+        a.Emit(ECALL);
+
+        emitWords(a, "arr", randomWords(rng, p.size, 0));
+    }
+
+    void buildCrc32(Assembler &a, RegWindow &regs, const KernelParams &p, std::mt19937 &rng) {
+        int ptr = regs.Take(), cnt = regs.Take(), crc = regs.Take(), poly = regs.Take();
+        int b = regs.Take(), t = regs.Take(), k = regs.Take();
+
+        // the unrolled loop is the 8 step bit loop, so unroll by a power of two up to 8
+        int bitUnroll = 1;
+        while (bitUnroll * 2 <= min(p.unroll, 8)) bitUnroll *= 2;
+
+        a.La(ptr, "data");
+        a.Li(crc, 0xFFFFFFFFu);
+        a.Li(poly, 0xEDB88320u);
+        if (p.size > 0) {
+            a.Li(cnt, static_cast<uint32_t>(p.size));
+            a.Label("byte");
+            a.I("lbu", b, ptr, 0);
+            a.R("xor", crc, crc, b);
+            if (bitUnroll < 8) {
+                a.I("addi", k, 0, 8 / bitUnroll);
+                a.Label("bits");
+            }
+            for (int s = 0; s < bitUnroll; ++s) {
+                // crc = (crc >> 1) ^ (poly & -(crc & 1)), without a branch
+                a.I("andi", t, crc, 1);
+                a.R("sub", t, 0, t);
+                a.R("and", t, t, poly);
+                a.I("srli", crc, crc, 1);
+                a.R("xor", crc, crc, t);
+            }
+            if (bitUnroll < 8) {
+                a.I("addi", k, k, -1);
+                a.B("bne", k, 0, "bits");
+            }
+            a.I("addi", ptr, ptr, 1);
+            a.I("addi", cnt, cnt, -1);
+            a.B("bne", cnt, 0, "byte");
+        }
+        a.I("xori", crc, crc, -1);
+        a.La(t, "result");
+        a.S("sw", crc, t, 0);
+        a.Emit(ECALL);
+
+        // bytes packed little endian into words
+        vector<uint32_t> words((p.size + 3) / 4, 0);
+        for (int i = 0; i < p.size; ++i) words[i / 4] |= (rng() & 0xFFu) << (8 * (i % 4));
+        emitWords(a, "data", words);
+        emitWords(a, "result", {0});
+    }
+
+    void buildMatmul(Assembler &a, RegWindow &regs, const KernelParams &p, std::mt19937 &rng) {
+        int n = p.size;
+        int pa = regs.Take(), pb = regs.Take(), pc = regs.Take(), i = regs.Take(), j = regs.Take(), k = regs.Take();
+        int sum = regs.Take(), x = regs.Take(), y = regs.Take(), prod = regs.Take(), t = regs.Take(), link = regs.Take();
+        int rowA = regs.Take(), colB = regs.Take(), stride = regs.Take(), rowStride = regs.Take();
+
+        // C[i][j] = sum over k of A[i][k] * B[k][j], row major n x n words
+        if (n == 0) {
+            a.Emit(ECALL);
+            return;
+        }
+        a.La(pc, "C");
+        a.La(rowA, "A");
+        a.Li(stride, static_cast<uint32_t>(4 * n * p.unroll));
+        a.Li(rowStride, static_cast<uint32_t>(4 * n));
+        a.Li(i, static_cast<uint32_t>(n));
+        a.Label("row");
+        a.La(colB, "B");
+        a.Li(j, static_cast<uint32_t>(n));
+        a.Label("col");
+        a.I("addi", pa, rowA, 0);
+        a.I("addi", pb, colB, 0);
+        a.I("addi", sum, 0, 0);
+        unrolledLoop(a, "inner", n, p.unroll, k,
+            [&](int count, const string &) {
+                for (int u = 0; u < count; ++u) {
+                    a.I("lw", x, pa, 4 * u);
+                    a.I("lw", y, pb, 4 * n * u);
+                    a.J(link, "mul");
+                    a.R("add", sum, sum, prod);
+                }
+            },
+            [&](int) {
+                a.I("addi", pa, pa, 4 * p.unroll);
+                a.R("add", pb, pb, stride);
+            });
+        a.S("sw", sum, pc, 0);
+        a.I("addi", pc, pc, 4);
+        a.I("addi", colB, colB, 4);
+        a.I("addi", j, j, -1);
+        a.B("bne", j, 0, "col");
+        a.R("add", rowA, rowA, rowStride);
+        a.I("addi", i, i, -1);
+        a.B("bne", i, 0, "row");
+        a.Emit(ECALL);
+        emitMul(a, x, y, prod, t, link);
+
+        emitWords(a, "A", randomWords(rng, n * n, 16));
+        emitWords(a, "B", randomWords(rng, n * n, 16));
+        emitWords(a, "C", vector<uint32_t>(n * n, 0));
+    }
+
+    void buildList(Assembler &a, RegWindow &regs, const KernelParams &p, std::mt19937 &rng) {
+        int ptr = regs.Take(), sum = regs.Take(), v = regs.Take(), t = regs.Take();
+
+        // nodes {next, value} visited in a shuffled order, so consecutive nodes are not adjacent
+        vector<int> order(p.size);
+        iota(order.begin(), order.end(), 0);
+        shuffle(order.begin(), order.end(), rng);
+
+        if (p.size > 0) a.La(ptr, "node" + to_string(order[0]));
+        else a.I("addi", ptr, 0, 0);
+        a.I("addi", sum, 0, 0);
+        a.Label("walk");
+        for (int u = 0; u < p.unroll; ++u) {
+            a.B("beq", ptr, 0, "done");
+            a.I("lw", v, ptr, 4);
+            a.R("add", sum, sum, v);
+            a.I("lw", ptr, ptr, 0);
+        }
+        a.J(0, "walk");
+        a.Label("done");
+        a.La(t, "result");
+        a.S("sw", sum, t, 0);
+        a.Emit(ECALL);
+
+        vector<int> next(p.size, -1);
+        for (int k = 0; k + 1 < p.size; ++k) next[order[k]] = order[k + 1];
+        for (int node = 0; node < p.size; ++node) {
+            a.Label("node" + to_string(node));
+            if (next[node] < 0) a.Word(0);
+            else a.WordAddress("node" + to_string(next[node]));
+            a.Word(rng() % 1000);
+        }
+        emitWords(a, "result", {0});
+    }
+}
+
+const vector<string> &KernelNames() {
+    static const vector<string> names = {"memcpy", "dot", "bubble", "insertion", "crc32", "matmul", "list"};
+    return names;
+}
+
+bool BuildKernel(const string &name, const KernelParams &params, vector<pair<string,string>> &program, string &error) {
+    if (params.size < 0 || params.size > 1 << 20) {
+        error = "size must be between 0 and 1048576";
+        return false;
+    }
+    if (params.unroll < 1 || params.unroll > MAX_UNROLL) {
+        error = "unroll must be between 1 and " + to_string(MAX_UNROLL);
+        return false;
+    }
+    if (params.regBase < 1 || params.regBase > 31) {
+        error = "register window must start between x1 and x31";
+        return false;
+    }
+    if (name == "matmul" && (params.size > 512 || 4 * params.size * (params.unroll - 1) > 2047)) {
+        error = "matmul column offsets do not fit a load immediate, lower size or unroll";
+        return false;
+    }
+
+    Assembler a;
+    RegWindow regs(params.regBase);
+    std::mt19937 rng(params.seed);
+
+    if (name == "memcpy") buildMemcpy(a, regs, params, rng);
+    else if (name == "dot") buildDot(a, regs, params, rng);
+    else if (name == "bubble") buildBubble(a, regs, params, rng);
+    else if (name == "insertion") buildInsertion(a, regs, params, rng);
+    else if (name == "crc32") buildCrc32(a, regs, params, rng);
+    else if (name == "matmul") buildMatmul(a, regs, params, rng);
+    else if (name == "list") buildList(a, regs, params, rng);
+    else {
+        error = "unknown kernel " + name;
+        return false;
+    }
+
+    if (regs.Overflow()) {
+        error = "kernel needs more than 31 registers";
+        return false;
+    }
+    if (!a.Resolve(params.baseAddress, error)) return false;
+    program = std::move(a.Program());
+    return true;
+}
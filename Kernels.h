@@ -0,0 +1,29 @@
+//
+// Library of parameterised RV32I benchmark kernels with their own initialised data section.
+//
+
+#ifndef KERNELS_H
+#define KERNELS_H
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+
+struct KernelParams {
+    int size = 16;           // elements (memcpy, dot, sort), bytes (crc32), nodes (list), matrix dimension (matmul)
+    int unroll = 1;          // copies of the innermost loop body per iteration
+    int regBase = 5;         // first register of the kernel's register window, wrapping from x31 to x1
+    uint32_t seed = 1;       // input data
+    uint32_t baseAddress = 0; // load address of the program, needed for absolute pointers in the data
+};
+
+// Code comes first and ends with ECALL, followed by the data words; results are stored
+// into the data section. Returns false with a reason if the parameters do not fit the kernel.
+bool BuildKernel(const string &name, const KernelParams &params, vector<pair<string,string>> &program, string &error);
+const vector<string> &KernelNames();
+
+
+#endif //KERNELS_H
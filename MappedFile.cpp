@@ -0,0 +1,58 @@
+//
+// Read-only memory mapping of a file, used to read cached and generated images without copying them.
+//
+
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::MappedFile(const string &path) {
+    Open(path);
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const string &path) {
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0) {
+        void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            length = 0;
+            return false;
+        }
+        // the files are read front to back
+        madvise(mapped, length, MADV_SEQUENTIAL);
+        data = static_cast<const char *>(mapped);
+    }
+    close(fd); // the mapping stays valid after the descriptor is closed
+
+    opened = true;
+    return true;
+}
+
+void MappedFile::Close() {
+    if (data != nullptr) {
+        munmap(const_cast<char *>(data), length);
+    }
+    data = nullptr;
+    length = 0;
+    opened = false;
+}
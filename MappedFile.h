@@ -0,0 +1,36 @@
+//
+// Read-only memory mapping of a file, used to read cached and generated images without copying them.
+//
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+using namespace std;
+
+
+class MappedFile {
+private:
+    const char *data = nullptr;
+    size_t length = 0;
+    bool opened = false;
+
+public:
+    MappedFile() = default;
+    explicit MappedFile(const string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool Open(const string &path); // false if the file is missing or cannot be mapped
+    void Close();
+    bool IsOpen() const { return opened; }
+    const char *Data() const { return data; }
+    size_t Size() const { return length; }
+    string_view View() const { return {data, length}; }
+};
+
+
+#endif //MAPPEDFILE_H
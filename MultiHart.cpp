@@ -0,0 +1,182 @@
+//
+// Multi-hart program images: one random program per hart in a single image, for memory
+// contention and memory ordering tests on multicore builds.
+//
+
+#include "MultiHart.h"
+#include "Assembler.h"
+#include "Disassembler.h"
+#include "Generator.h"
+#include <random>
+
+using namespace std;
+
+namespace {
+    const int MAX_HARTS = 64;
+    const int MAX_COUNT = 1 << 20;
+    const int SHARED_REG = 31;
+    const int PRIVATE_REG = 30;
+    const int LAST_DATA_REG = 29; // body instructions write x1..x29 only
+    const int MAX_SKIP = 64;      // furthest a body branch or jump skips ahead
+    const double BRANCH_SHARE = 0.15; // of the instructions that are neither memory accesses nor fences
+    const uint32_t ECALL = 0x00000073;
+    const uint32_t FENCE = 0x0330000F;     // fence rw, rw
+    const uint32_t FENCE_TSO = 0x8330000F;
+    const int MHARTID = 0xF14;
+    const double SLACK = 1e-9; // shares given as decimals may add up to a hair over 1
+
+    struct Access {
+        const char *name;
+        int size;
+        bool store;
+    };
+
+    const Access ACCESSES[] = {
+        {"lw", 4, false}, {"lh", 2, false}, {"lhu", 2, false}, {"lb", 1, false}, {"lbu", 1, false},
+        {"sw", 4, true}, {"sh", 2, true}, {"sb", 1, true},
+    };
+
+    bool isPowerOfTwo(int v) {
+        return v > 0 && (v & (v - 1)) == 0;
+    }
+
+    bool isRatio(double v) {
+        return v >= 0.0 && v <= 1.0;
+    }
+
+    // a random R, I or U instruction that neither touches memory, nor jumps, nor writes the base registers
+    uint32_t aluInstruction(Generator &source, std::mt19937 &rng) {
+        static const char formats[] = {'R', 'I', 'U'};
+        for (;;) {
+            uint32_t word = static_cast<uint32_t>(stoul(source.GenerateOne(formats[rng() % 3]).first, nullptr, 2));
+            DecodedInstr d = Decode(word);
+            if (d.format != 'L' && d.rd <= LAST_DATA_REG) return word;
+        }
+    }
+
+    void emitAccess(Assembler &a, const MultiHartParams &p, int hart, std::mt19937 &rng, HartSummary &summary) {
+        const Access &access = ACCESSES[rng() % (sizeof(ACCESSES) / sizeof(ACCESSES[0]))];
+        int wordsPerLine = p.lineBytes / 4;
+        int line = static_cast<int>(rng() % static_cast<uint32_t>(p.lines));
+        int sub = static_cast<int>(rng() % static_cast<uint32_t>(4 / access.size)) * access.size;
+
+        // words 0..harts-1 of a shared line belong to one hart each, the words after them to everyone
+        int base, word;
+        double kind = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        if (kind < p.sharing) {
+            base = SHARED_REG;
+            word = p.harts + static_cast<int>(rng() % static_cast<uint32_t>(wordsPerLine - p.harts));
+            summary.shared++;
+        } else if (kind < p.sharing + p.falseSharing) {
+            base = SHARED_REG;
+            word = hart;
+            summary.falseShared++;
+        } else {
+            base = PRIVATE_REG;
+            word = static_cast<int>(rng() % static_cast<uint32_t>(wordsPerLine));
+            summary.privateAccesses++;
+        }
+
+        int32_t offset = line * p.lineBytes + word * 4 + sub;
+        int reg = static_cast<int>(rng() % (access.store ? 32 : LAST_DATA_REG + 1));
+        if (access.store) a.S(access.name, reg, base, offset);
+        else a.I(access.name, reg, base, offset);
+    }
+
+    void emitHart(Assembler &a, const MultiHartParams &p, int hart, Generator &source, std::mt19937 &rng,
+                  HartSummary &summary) {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        static const char *branches[] = {"beq", "bne", "blt", "bge", "bltu", "bgeu"};
+
+        a.Label("hart" + to_string(hart));
+        summary.entry = a.Size();
+        a.La(SHARED_REG, "shared");
+        a.La(PRIVATE_REG, "private" + to_string(hart));
+
+        for (int i = 0; i < p.count; ++i) {
+            // forward only, at most up to the final ECALL, so every hart finishes
+            int skip = 1 + static_cast<int>(rng() % static_cast<uint32_t>(min(MAX_SKIP, p.count - i)));
+            double kind = unit(rng);
+            if (kind < p.memory) {
+                emitAccess(a, p, hart, rng, summary);
+            } else if (kind < p.memory + p.fences) {
+                a.Emit(rng() % 2 == 0 ? FENCE : FENCE_TSO);
+                summary.fences++;
+            } else if (unit(rng) < BRANCH_SHARE) {
+                if (rng() % 4 == 0) a.J(static_cast<int>(rng() % (LAST_DATA_REG + 1)), skip * 4);
+                else a.B(branches[rng() % 6], static_cast<int>(rng() % 32), static_cast<int>(rng() % 32), skip * 4);
+            } else {
+                a.Emit(aluInstruction(source, rng));
+            }
+        }
+        a.Emit(ECALL);
+    }
+}
+
+bool BuildMultiHart(const MultiHartParams &params, vector<pair<string,string>> &program,
+                    vector<HartSummary> &harts, string &error) {
+    const MultiHartParams &p = params;
+    if (!isPowerOfTwo(p.lineBytes) || p.lineBytes < 8 || p.lineBytes > 2048) {
+        error = "line size must be a power of two between 8 and 2048 bytes";
+        return false;
+    }
+    if (p.harts < 1 || p.harts > MAX_HARTS || p.harts >= p.lineBytes / 4) {
+        error = "harts must be between 1 and " + to_string(min(MAX_HARTS, p.lineBytes / 4 - 1)) +
+                ", a shared line holds one word per hart plus shared words";
+        return false;
+    }
+    if (p.count < 0 || p.count > MAX_COUNT) {
+        error = "instructions per hart must be between 0 and " + to_string(MAX_COUNT);
+        return false;
+    }
+    if (p.lines < 1 || p.lines * p.lineBytes > 2048) {
+        error = "lines * line size must be between one line and 2048 bytes, the reach of a load offset";
+        return false;
+    }
+    if (!isRatio(p.memory) || !isRatio(p.fences) || p.memory + p.fences > 1.0 + SLACK) {
+        error = "memory and fence shares must be between 0 and 1 and add up to at most 1";
+        return false;
+    }
+    if (!isRatio(p.sharing) || !isRatio(p.falseSharing) || p.sharing + p.falseSharing > 1.0 + SLACK) {
+        error = "sharing and false sharing shares must be between 0 and 1 and add up to at most 1";
+        return false;
+    }
+    if (p.baseAddress % 4 != 0) {
+        error = "base address must be 4-byte aligned";
+        return false;
+    }
+
+    Assembler a;
+    std::mt19937 rng(p.seed);
+    Generator source('I', 0, 'M');
+    source.SetSeed(p.seed ^ 0x9E3779B9u);
+
+    // reset vector: every hart reads its id and jumps to its own code, auipc-relative so any size fits
+    a.Csr("csrrs", 5, MHARTID, 0);
+    for (int h = 0; h < p.harts; ++h) {
+        string next = "dispatch" + to_string(h + 1);
+        a.I("addi", 6, 0, h);
+        a.B("bne", 5, 6, next);
+        a.La(7, "hart" + to_string(h));
+        a.I("jalr", 0, 7, 0);
+        a.Label(next);
+    }
+    a.Emit(ECALL); // harts the image has no code for
+
+    harts.assign(p.harts, HartSummary());
+    for (int h = 0; h < p.harts; ++h) emitHart(a, p, h, source, rng, harts[h]);
+
+    // data: shared lines, then each hart's private lines, all line aligned
+    while ((p.baseAddress + a.Size() * 4) % p.lineBytes != 0) a.Word(0);
+    int wordsPerArea = p.lines * p.lineBytes / 4;
+    a.Label("shared");
+    for (int w = 0; w < wordsPerArea; ++w) a.Word(rng());
+    for (int h = 0; h < p.harts; ++h) {
+        a.Label("private" + to_string(h));
+        for (int w = 0; w < wordsPerArea; ++w) a.Word(rng());
+    }
+
+    if (!a.Resolve(p.baseAddress, error)) return false;
+    program = std::move(a.Program());
+    return true;
+}
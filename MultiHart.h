@@ -0,0 +1,46 @@
+//
+// Multi-hart program images: one random program per hart in a single image, for memory
+// contention and memory ordering tests on multicore builds.
+//
+
+#ifndef MULTIHART_H
+#define MULTIHART_H
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+
+struct MultiHartParams {
+    int harts = 2;
+    int count = 64;            // body instructions per hart, before its final ECALL
+    double memory = 0.4;       // share of body instructions that are loads or stores
+    double sharing = 0.4;      // share of accesses to the words every hart uses on the shared lines
+    double falseSharing = 0.3; // share of accesses to the hart's own word on a shared line, the rest go to private lines
+    double fences = 0.05;      // share of body instructions that are FENCE or FENCE.TSO
+    int lines = 4;             // shared cache lines, and private lines per hart
+    int lineBytes = 64;
+    uint32_t seed = 1;
+    uint32_t baseAddress = 0;  // load address of the image, the reset vector
+};
+
+struct HartSummary {
+    size_t entry = 0; // instruction index of the hart's first instruction
+    int shared = 0;
+    int falseShared = 0;
+    int privateAccesses = 0;
+    int fences = 0;
+};
+
+// The reset vector reads mhartid and jumps to that hart's code; harts without code stop at an
+// ECALL. Each hart points x31 at the shared lines and x30 at its private lines, never writes
+// either, only branches forward and ends with ECALL. The line-aligned data section follows
+// the code. Returns false with a reason if the parameters do not fit.
+bool BuildMultiHart(const MultiHartParams &params, vector<pair<string,string>> &program,
+                    vector<HartSummary> &harts, string &error);
+
+
+#endif //MULTIHART_H
@@ -0,0 +1,172 @@
+//
+// Corpus based mutation: imports existing TC/Mem programs and derives variants from them.
+//
+
+#include "Mutator.h"
+#include "Disassembler.h"
+#include "ImageReader.h"
+#include "MappedFile.h"
+#include <bitset>
+
+using namespace std;
+
+namespace {
+    int32_t wrap(int64_t value, int bits) {
+        uint32_t m = 1u << (bits - 1);
+        uint32_t v = static_cast<uint32_t>(value) & ((1u << bits) - 1);
+        return static_cast<int32_t>((v ^ m) - m);
+    }
+
+    const int MAX_TRIES = 8;
+}
+
+Mutator::Mutator(uint32_t seed)
+    : rng(seed), source('I', 0, 'M') {
+    source.SetSeed(seed ^ 0x9E3779B9u);
+}
+
+bool Mutator::AddFile(const string &path, bool bigEndian, unsigned threads, string &error) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        error = "could not open file";
+        return false;
+    }
+    ParsedImage image;
+    if (!ReadImage(file, bigEndian, threads, image, error)) return false;
+
+    // zero padding from wide layouts is not part of the program
+    vector<uint32_t> words = std::move(image.words);
+    while (!words.empty() && words.back() == 0) words.pop_back();
+    if (words.empty()) {
+        error = "no instructions";
+        return false;
+    }
+    AddProgram(std::move(words));
+    return true;
+}
+
+void Mutator::AddProgram(vector<uint32_t> words) {
+    corpus.push_back(std::move(words));
+}
+
+vector<uint32_t> Mutator::Mutate(int mutations) {
+    if (corpus.empty()) return {};
+
+    const vector<uint32_t> &base = corpus[rng() % corpus.size()];
+    vector<uint32_t> body(base.begin(), base.end() - 1);
+
+    for (int m = 0; m < mutations; ++m) {
+        switch (body.empty() ? 2 : rng() % 4) {
+            case 0: SwapOperands(body); break;
+            case 1: TweakImmediate(body); break;
+            case 2: Insert(body); break;
+            default: Splice(body); break;
+        }
+    }
+
+    body.push_back(base.back());
+    return body;
+}
+
+uint32_t Mutator::MutateOne(uint32_t word) {
+    vector<uint32_t> body{word};
+    if (rng() % 2 == 0) SwapOperands(body);
+    if (body[0] == word) TweakImmediate(body);
+    if (body[0] == word) SwapOperands(body);
+    if (body[0] != word) return body[0];
+
+    static const char formats[] = {'R', 'I', 'S', 'B', 'U', 'J'};
+    return static_cast<uint32_t>(stoul(source.GenerateOne(formats[rng() % 6]).first, nullptr, 2));
+}
+
+void Mutator::SwapOperands(vector<uint32_t> &body) {
+    for (int t = 0; t < MAX_TRIES; ++t) {
+        uint32_t &word = body[rng() % body.size()];
+        DecodedInstr d = Decode(word);
+        switch (d.format) {
+            case 'R':
+            case 'S':
+            case 'B':
+                if (d.rs1 == d.rs2) continue;
+                swap(d.rs1, d.rs2);
+                break;
+            case 'I':
+            case 'L':
+                if (d.rd == d.rs1) continue;
+                swap(d.rd, d.rs1);
+                break;
+            default:
+                continue;
+        }
+        word = Encode(d);
+        return;
+    }
+}
+
+void Mutator::TweakImmediate(vector<uint32_t> &body) {
+    std::uniform_int_distribution<int> small(1, 16);
+    bool flip = rng() % 2 == 0;
+    int delta = small(rng) * (rng() % 2 == 0 ? 1 : -1);
+
+    for (int t = 0; t < MAX_TRIES; ++t) {
+        uint32_t &word = body[rng() % body.size()];
+        DecodedInstr d = Decode(word);
+        int bits;
+        int step = 1; // branch and jump targets stay 4-byte aligned
+        switch (d.format) {
+            case 'I':
+                bits = (d.word & 0x3000) == 0x1000 ? 5 : 12;
+                break;
+            case 'L':
+            case 'S': bits = 12; break;
+            case 'B': bits = 13; step = 4; break;
+            case 'U': bits = 20; break;
+            case 'J': bits = 21; step = 4; break;
+            default: continue;
+        }
+
+        if (bits == 5) {
+            d.imm = (d.imm + delta) & 0x1F;
+        } else if (flip) {
+            std::uniform_int_distribution<int> bit(step == 4 ? 2 : 0, bits - 1);
+            d.imm = wrap(static_cast<int64_t>(d.imm) ^ (int64_t(1) << bit(rng)), bits);
+        } else {
+            d.imm = wrap(static_cast<int64_t>(d.imm) + static_cast<int64_t>(delta) * step, bits);
+        }
+        word = Encode(d);
+        return;
+    }
+}
+
+void Mutator::Insert(vector<uint32_t> &body) {
+    uint32_t word;
+    const vector<uint32_t> &donor = corpus[rng() % corpus.size()];
+    if (donor.size() > 1 && rng() % 2 == 0) {
+        // an instruction that already appears in a meaningful program
+        word = donor[rng() % (donor.size() - 1)];
+    } else {
+        static const char formats[] = {'R', 'I', 'S', 'B', 'U', 'J'};
+        word = static_cast<uint32_t>(stoul(source.GenerateOne(formats[rng() % 6]).first, nullptr, 2));
+    }
+    body.insert(body.begin() + static_cast<long>(rng() % (body.size() + 1)), word);
+}
+
+void Mutator::Splice(vector<uint32_t> &body) {
+    const vector<uint32_t> &other = corpus[rng() % corpus.size()];
+    size_t otherBody = other.size() - 1;
+
+    // our prefix followed by the other program's tail
+    size_t cut = rng() % (body.size() + 1);
+    size_t from = rng() % (otherBody + 1);
+    body.resize(cut);
+    body.insert(body.end(), other.begin() + static_cast<long>(from), other.begin() + static_cast<long>(otherBody));
+}
+
+vector<pair<string,string>> Mutator::ToProgram(const vector<uint32_t> &words) {
+    vector<pair<string,string>> program;
+    program.reserve(words.size());
+    for (uint32_t w : words) {
+        program.emplace_back(bitset<32>(w).to_string(), Disassemble(w));
+    }
+    return program;
+}
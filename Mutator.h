@@ -0,0 +1,42 @@
+//
+// Corpus based mutation: imports existing TC/Mem programs and derives variants from them.
+//
+
+#ifndef MUTATOR_H
+#define MUTATOR_H
+#include <string>
+#include <utility>
+#include <random>
+#include <vector>
+#include <cstdint>
+#include "Generator.h"
+
+using namespace std;
+
+
+// Variants keep the corpus program's final instruction (normally the SYS instruction that ends
+// it) and mutate the body with operand swaps, immediate tweaks, insertions and splices.
+class Mutator {
+private:
+    std::mt19937 rng;
+    Generator source; // fresh random instructions for insertions
+    vector<vector<uint32_t>> corpus;
+
+    void SwapOperands(vector<uint32_t> &body);
+    void TweakImmediate(vector<uint32_t> &body);
+    void Insert(vector<uint32_t> &body);
+    void Splice(vector<uint32_t> &body);
+
+public:
+    explicit Mutator(uint32_t seed);
+    bool AddFile(const string &path, bool bigEndian, unsigned threads, string &error); // TC or Mem file
+    void AddProgram(vector<uint32_t> words);
+    size_t CorpusSize() const { return corpus.size(); }
+    vector<uint32_t> Mutate(int mutations); // a variant of a random corpus program
+    uint32_t MutateOne(uint32_t word);      // operand swap or immediate tweak, a fresh instruction if neither applies
+
+    static vector<pair<string,string>> ToProgram(const vector<uint32_t> &words); // Generator's binary/assembly pairs
+};
+
+
+#endif //MUTATOR_H
@@ -0,0 +1,230 @@
+//
+// In-place patching of fixed-record TC files and their Mem files.
+//
+
+#include "Patcher.h"
+#include <algorithm>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+    const string HEADER = "// fixed-record layout";
+
+    bool readAt(int fd, char *buffer, size_t length, size_t offset) {
+        while (length > 0) {
+            ssize_t n = pread(fd, buffer, length, static_cast<off_t>(offset));
+            if (n <= 0) return false;
+            buffer += n;
+            length -= static_cast<size_t>(n);
+            offset += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool writeAt(int fd, const char *buffer, size_t length, size_t offset) {
+        while (length > 0) {
+            ssize_t n = pwrite(fd, buffer, length, static_cast<off_t>(offset));
+            if (n <= 0) return false;
+            buffer += n;
+            length -= static_cast<size_t>(n);
+            offset += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    size_t fileSize(int fd) {
+        struct stat st{};
+        return fstat(fd, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+    }
+}
+
+Patcher::~Patcher() {
+    Close();
+}
+
+void Patcher::Close() {
+    if (tcFd >= 0) close(tcFd);
+    if (memFd >= 0) close(memFd);
+    tcFd = memFd = -1;
+    records = 0;
+    instructions = 0;
+}
+
+bool Patcher::Open(const string &tcPath, const string &memPath, string &error) {
+    Close();
+    tcFd = open(tcPath.c_str(), O_RDWR);
+    memFd = open(memPath.c_str(), O_RDWR);
+    if (tcFd < 0 || memFd < 0) {
+        error = "could not open " + (tcFd < 0 ? tcPath : memPath) + " for writing";
+        Close();
+        return false;
+    }
+
+    // the header line and the first record are enough to locate every other record
+    size_t tcSize = fileSize(tcFd);
+    string head(min<size_t>(tcSize, 4096), '\0');
+    if (!readAt(tcFd, head.data(), head.size(), 0) || head.rfind(HEADER, 0) != 0) {
+        error = "not a fixed-record TC file, write it with --records fixed";
+        Close();
+        return false;
+    }
+    size_t headerEnd = head.find('\n');
+    size_t recordEnd = headerEnd == string::npos ? string::npos : head.find('\n', headerEnd + 1);
+    if (recordEnd == string::npos) {
+        error = "TC file has no records";
+        Close();
+        return false;
+    }
+
+    istringstream fields(head.substr(HEADER.size(), headerEnd - HEADER.size()));
+    string field;
+    slot = 0;
+    long long count = -1;
+    try {
+        while (fields >> field) {
+            size_t eq = field.find('=');
+            if (eq == string::npos) continue;
+            string key = field.substr(0, eq), value = field.substr(eq + 1);
+            if (key == "width") wordBits = stoi(value);
+            else if (key == "endian") bigEndian = value == "big";
+            else if (key == "slot") slot = stoi(value);
+            else if (key == "instructions") count = stoll(value);
+        }
+    } catch (...) {
+        slot = 0; // reported as a malformed header below
+    }
+
+    headerBytes = headerEnd + 1;
+    recordBytes = recordEnd - headerEnd;
+    string first = head.substr(headerBytes, recordBytes);
+    size_t bits = first.find("'b");
+    size_t comment = first.find("; // ");
+    size_t wordBytes = WordBytes();
+    size_t slots = wordBytes < 4 ? 1 : wordBytes / 4;
+    if ((wordBits != 8 && wordBits != 16 && wordBits != 32 && wordBits != 64 && wordBits != 128) || slot <= 0 ||
+        bits == string::npos || comment == string::npos || bits + 2 + wordBits > comment ||
+        comment + 5 + slots * (slot + 3) - 3 > recordBytes - 1) {
+        error = "malformed fixed-record header or first record";
+        Close();
+        return false;
+    }
+    bitsOffset = bits + 2;
+    commentOffset = comment + 5;
+
+    if ((tcSize - headerBytes) % recordBytes != 0) {
+        error = "TC records are not all the same length";
+        Close();
+        return false;
+    }
+    records = (tcSize - headerBytes) / recordBytes;
+    if (count < 0 || static_cast<size_t>(count) > records * wordBytes / 4 ||
+        static_cast<size_t>(count) * 4 <= (records - 1) * wordBytes) {
+        error = "header instruction count does not match the records";
+        Close();
+        return false;
+    }
+    instructions = static_cast<size_t>(count);
+    if (fileSize(memFd) != records * MemRecordBytes()) {
+        error = "Mem file does not match the TC file";
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool Patcher::Read(size_t index, uint32_t &word, string &error) const {
+    if (index >= Instructions()) {
+        error = "instruction " + to_string(index) + " is past the end of the program";
+        return false;
+    }
+    size_t wordBytes = WordBytes();
+    size_t firstRecord = index * 4 / wordBytes;
+    size_t lastRecord = (index * 4 + 3) / wordBytes;
+    string mem((lastRecord - firstRecord + 1) * MemRecordBytes(), '\0');
+    if (!readAt(memFd, mem.data(), mem.size(), firstRecord * MemRecordBytes())) {
+        error = "could not read the Mem file";
+        return false;
+    }
+
+    word = 0;
+    for (size_t k = 0; k < 4; ++k) {
+        size_t address = index * 4 + k;
+        size_t record = address / wordBytes - firstRecord;
+        size_t b = address % wordBytes;
+        size_t at = record * MemRecordBytes() + (bigEndian ? b : wordBytes - 1 - b) * 8;
+        uint32_t value = static_cast<uint32_t>(stoul(mem.substr(at, 8), nullptr, 2));
+        word |= value << (bigEndian ? (3 - k) * 8 : k * 8);
+    }
+    return true;
+}
+
+void Patcher::PatchRecords(char *tc, char *mem, size_t firstRecord, const InstructionPatch &patch) const {
+    size_t wordBytes = WordBytes();
+    for (size_t k = 0; k < 4; ++k) {
+        // same byte placement as Generator::WordBits
+        size_t address = patch.index * 4 + k;
+        size_t record = address / wordBytes - firstRecord;
+        size_t b = address % wordBytes;
+        size_t position = (bigEndian ? b : wordBytes - 1 - b) * 8;
+        uint8_t value = static_cast<uint8_t>(patch.word >> (bigEndian ? (3 - k) * 8 : k * 8));
+        for (int bit = 0; bit < 8; ++bit) {
+            char c = (value >> (7 - bit)) & 1 ? '1' : '0';
+            tc[record * recordBytes + bitsOffset + position + bit] = c;
+            mem[record * MemRecordBytes() + position + bit] = c;
+        }
+    }
+
+    // narrow words keep the assembly on the instruction's first record, wide words have a slot per instruction
+    size_t record = patch.index * 4 / wordBytes - firstRecord;
+    size_t column = wordBytes < 4 ? 0 : patch.index % (wordBytes / 4);
+    string text = patch.assembly.substr(0, static_cast<size_t>(slot));
+    text.resize(static_cast<size_t>(slot), ' ');
+    copy(text.begin(), text.end(), tc + record * recordBytes + commentOffset + column * (slot + 3));
+}
+
+bool Patcher::Apply(vector<InstructionPatch> patches, string &error) {
+    if (tcFd < 0) {
+        error = "no files open";
+        return false;
+    }
+    stable_sort(patches.begin(), patches.end(),
+                [](const InstructionPatch &a, const InstructionPatch &b) { return a.index < b.index; });
+    if (!patches.empty() && patches.back().index >= Instructions()) {
+        error = "instruction " + to_string(patches.back().index) + " is past the end of the program";
+        return false;
+    }
+
+    // neighbouring instructions share one read and one write of their records
+    size_t wordBytes = WordBytes();
+    string tc, mem;
+    for (size_t start = 0; start < patches.size();) {
+        size_t firstRecord = patches[start].index * 4 / wordBytes;
+        size_t lastRecord = (patches[start].index * 4 + 3) / wordBytes;
+        size_t end = start + 1;
+        while (end < patches.size() && patches[end].index * 4 / wordBytes <= lastRecord + 1) {
+            lastRecord = (patches[end].index * 4 + 3) / wordBytes;
+            end++;
+        }
+
+        size_t count = lastRecord - firstRecord + 1;
+        tc.resize(count * recordBytes);
+        mem.resize(count * MemRecordBytes());
+        size_t tcOffset = headerBytes + firstRecord * recordBytes;
+        size_t memOffset = firstRecord * MemRecordBytes();
+        if (!readAt(tcFd, tc.data(), tc.size(), tcOffset) || !readAt(memFd, mem.data(), mem.size(), memOffset)) {
+            error = "could not read records " + to_string(firstRecord) + "-" + to_string(lastRecord);
+            return false;
+        }
+        for (size_t p = start; p < end; ++p) PatchRecords(tc.data(), mem.data(), firstRecord, patches[p]);
+        if (!writeAt(tcFd, tc.data(), tc.size(), tcOffset) || !writeAt(memFd, mem.data(), mem.size(), memOffset)) {
+            error = "could not write records " + to_string(firstRecord) + "-" + to_string(lastRecord);
+            return false;
+        }
+        start = end;
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+//
+// In-place patching of fixed-record TC files and their Mem files: only the records of changed
+// instructions are read and rewritten, so an edit costs the same on a small or a huge program.
+//
+
+#ifndef PATCHER_H
+#define PATCHER_H
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+
+struct InstructionPatch {
+    size_t index = 0;   // instruction number in the program
+    uint32_t word = 0;
+    string assembly;
+};
+
+// Works on files written with --records fixed; the TC header gives the layout and the first
+// data line gives the byte offsets shared by every record.
+class Patcher {
+private:
+    int tcFd = -1;
+    int memFd = -1;
+    int wordBits = 8;
+    bool bigEndian = false;
+    int slot = 0;
+    size_t headerBytes = 0;   // TC bytes before the first record
+    size_t recordBytes = 0;   // TC bytes per record, newline included
+    size_t bitsOffset = 0;    // offset of the bit string in a TC record
+    size_t commentOffset = 0; // offset of the first assembly slot in a TC record
+    size_t records = 0;
+    size_t instructions = 0;  // from the header, the zero padding of a wide last word is not counted
+
+    size_t WordBytes() const { return static_cast<size_t>(wordBits) / 8; }
+    size_t MemRecordBytes() const { return static_cast<size_t>(wordBits) + 1; }
+    void PatchRecords(char *tc, char *mem, size_t firstRecord, const InstructionPatch &patch) const;
+
+public:
+    Patcher() = default;
+    ~Patcher();
+    Patcher(const Patcher &) = delete;
+    Patcher &operator=(const Patcher &) = delete;
+
+    bool Open(const string &tcPath, const string &memPath, string &error);
+    void Close();
+    size_t Instructions() const { return instructions; }
+    bool Read(size_t index, uint32_t &word, string &error) const;
+    bool Apply(vector<InstructionPatch> patches, string &error); // pwrites only the touched records
+};
+
+
+#endif //PATCHER_H
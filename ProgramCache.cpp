@@ -0,0 +1,182 @@
+//
+// On-disk cache of generated programs, keyed by a hash of the generator configuration.
+//
+
+#include "ProgramCache.h"
+#include "Disassembler.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+    const char CACHE_MAGIC[4] = {'R', 'P', 'G', 'C'};
+    const uint32_t CACHE_VERSION = 2;
+
+    struct CacheHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t count; // number of instructions
+        uint32_t texts; // text index records after the words: u32 index, u32 length, the text
+    };
+}
+
+ProgramCache::ProgramCache(const string &dir, uint64_t maxBytes)
+    : dir(dir), maxBytes(maxBytes) {
+    error_code ec;
+    fs::create_directories(dir, ec);
+}
+
+uint64_t ProgramCache::Key(const string &config) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : config) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+string ProgramCache::EntryPath(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.rpc", static_cast<unsigned long long>(key));
+    return (fs::path(dir) / name).string();
+}
+
+bool ProgramCache::Load(uint64_t key, CachedProgram &program) {
+    string path = EntryPath(key);
+    MappedFile &file = program.file;
+    if (!file.Open(path) || file.Size() < sizeof(CacheHeader)) {
+        misses++;
+        return false;
+    }
+
+    CacheHeader header;
+    memcpy(&header, file.Data(), sizeof(header));
+    size_t wordsBytes = static_cast<size_t>(header.count) * 4;
+    bool valid = memcmp(header.magic, CACHE_MAGIC, 4) == 0 && header.version == CACHE_VERSION &&
+                 file.Size() >= sizeof(header) + wordsBytes;
+
+    // the words are used in place, only the text index is copied
+    program.texts.clear();
+    size_t pos = sizeof(header) + wordsBytes;
+    for (uint32_t t = 0; valid && t < header.texts; ++t) {
+        uint32_t record[2];
+        if (file.Size() - pos < sizeof(record)) {
+            valid = false;
+            break;
+        }
+        memcpy(record, file.Data() + pos, sizeof(record));
+        pos += sizeof(record);
+        if (record[0] >= header.count || file.Size() - pos < record[1]) {
+            valid = false;
+            break;
+        }
+        program.texts.emplace(record[0], string(file.Data() + pos, record[1]));
+        pos += record[1];
+    }
+    if (!valid || pos != file.Size()) {
+        cout << "[CACHE] Ignoring corrupt entry " << path << endl;
+        file.Close();
+        misses++;
+        return false;
+    }
+    program.words = reinterpret_cast<const uint32_t *>(file.Data() + sizeof(header)); // mappings are page aligned
+    program.count = header.count;
+
+    // refresh the entry so it is the last one to be evicted
+    error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    hits++;
+    return true;
+}
+
+void ProgramCache::Store(uint64_t key, const vector<pair<string,string>> &program) {
+    vector<uint32_t> words(program.size());
+    string texts;
+    uint32_t textCount = 0;
+    for (size_t i = 0; i < program.size(); ++i) {
+        words[i] = static_cast<uint32_t>(stoul(program[i].first, nullptr, 2));
+        if (program[i].second == Disassemble(words[i])) continue;
+        uint32_t record[2] = {static_cast<uint32_t>(i), static_cast<uint32_t>(program[i].second.size())};
+        texts.append(reinterpret_cast<const char *>(record), sizeof(record));
+        texts += program[i].second;
+        textCount++;
+    }
+
+    CacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.count = static_cast<uint32_t>(program.size());
+    header.texts = textCount;
+
+    // write under a temporary name and rename, so concurrent runs never see a partial entry
+    string path = EntryPath(key);
+    string tmpPath = path + ".tmp" + to_string(getpid());
+    {
+        ofstream ofs(tmpPath, ios::binary);
+        if (!ofs.is_open()) {
+            cout << "[CACHE] Could not write " << tmpPath << endl;
+            return;
+        }
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char *>(words.data()), static_cast<streamsize>(words.size() * 4));
+        ofs.write(texts.data(), static_cast<streamsize>(texts.size()));
+    }
+    error_code ec;
+    fs::rename(tmpPath, path, ec);
+    if (ec) {
+        fs::remove(tmpPath, ec);
+        return;
+    }
+
+    Evict();
+}
+
+void ProgramCache::Evict() {
+    struct Entry {
+        fs::path path;
+        uint64_t size;
+        fs::file_time_type used;
+    };
+    vector<Entry> entries;
+    uint64_t total = 0;
+
+    error_code ec;
+    for (auto &file : fs::directory_iterator(dir, ec)) {
+        if (file.path().extension() != ".rpc") continue;
+        Entry e{file.path(), file.file_size(ec), file.last_write_time(ec)};
+        total += e.size;
+        entries.push_back(e);
+    }
+    if (total <= maxBytes) return;
+
+    sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.used < b.used; });
+
+    // never drop the most recent entry, even if it alone is over the limit
+    for (size_t i = 0; i + 1 < entries.size() && total > maxBytes; ++i) {
+        if (fs::remove(entries[i].path, ec)) {
+            total -= entries[i].size;
+            evictions++;
+        }
+    }
+}
+
+void ProgramCache::Report() const {
+    int entries = 0;
+    uint64_t total = 0;
+    error_code ec;
+    for (auto &file : fs::directory_iterator(dir, ec)) {
+        if (file.path().extension() != ".rpc") continue;
+        entries++;
+        total += file.file_size(ec);
+    }
+
+    cout << "[CACHE] hits=" << hits << " misses=" << misses << " evicted=" << evictions
+         << " entries=" << entries << " size=" << total << "/" << maxBytes << " bytes" << endl;
+}
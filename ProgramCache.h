@@ -0,0 +1,51 @@
+//
+// On-disk cache of generated programs, keyed by a hash of the generator configuration.
+//
+
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include "MappedFile.h"
+
+using namespace std;
+
+
+// A cache hit: words point into the mapped entry, texts holds the few instructions whose
+// recorded assembly is not their disassembly (hand-written spellings such as "lui x1, 0x1")
+struct CachedProgram {
+    MappedFile file;
+    const uint32_t *words = nullptr;
+    size_t count = 0;
+    unordered_map<size_t, string> texts;
+};
+
+// Each entry is one file "<key>.rpc" holding a small header, the instructions as packed
+// 32-bit words and a text index for instructions whose assembly differs from Disassemble().
+// Entries are evicted least recently used first once the directory grows past maxBytes;
+// a hit refreshes the entry's modification time.
+class ProgramCache {
+private:
+    string dir;
+    uint64_t maxBytes;
+    int hits = 0;
+    int misses = 0;
+    int evictions = 0;
+
+    string EntryPath(uint64_t key) const;
+    void Evict();
+
+public:
+    ProgramCache(const string &dir, uint64_t maxBytes);
+    static uint64_t Key(const string &config); // FNV-1a 64 of the configuration string
+    bool Load(uint64_t key, CachedProgram &program);
+    void Store(uint64_t key, const vector<pair<string,string>> &program);
+    void Report() const;
+};
+
+
+#endif //PROGRAMCACHE_H
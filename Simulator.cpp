@@ -0,0 +1,142 @@
+//
+// Small RV32I reference model, used to compute at generation time what a program leaves behind.
+//
+
+#include "Simulator.h"
+#include "Disassembler.h"
+#include <cstring>
+#include <cstdio>
+
+using namespace std;
+
+uint8_t &Simulator::Byte(uint32_t addr) {
+    auto it = pages.find(addr >> 12);
+    if (it == pages.end()) {
+        it = pages.emplace(addr >> 12, array<uint8_t, 4096>{}).first;
+    }
+    return it->second[addr & 0xFFF];
+}
+
+uint32_t Simulator::Read(uint32_t addr, int bytes) {
+    uint32_t value = 0;
+    for (int b = 0; b < bytes; ++b) value |= uint32_t(Byte(addr + b)) << (8 * b);
+    return value;
+}
+
+void Simulator::Write(uint32_t addr, uint32_t value, int bytes) {
+    for (int b = 0; b < bytes; ++b) Byte(addr + b) = static_cast<uint8_t>(value >> (8 * b));
+}
+
+void Simulator::LoadCode(uint32_t base, const vector<uint32_t> &words) {
+    for (size_t i = 0; i < words.size(); ++i) Write(base + static_cast<uint32_t>(i * 4), words[i], 4);
+    codeStart = base;
+    codeEnd = base + static_cast<uint32_t>(words.size() * 4);
+    pc = base;
+}
+
+bool Simulator::Run(uint64_t maxSteps, string &error) {
+    auto fail = [&](const string &why) {
+        char where[24];
+        snprintf(where, sizeof(where), " at pc 0x%08x", pc);
+        error = why + where;
+        return false;
+    };
+
+    for (uint64_t step = 0; step < maxSteps; ++step) {
+        if (pc == codeEnd) return true; // ran past the last instruction
+        if (pc < codeStart || pc > codeEnd || pc % 4 != 0) return fail("jump outside the program");
+
+        DecodedInstr d = Decode(Read(pc, 4));
+        if (!d.valid) return fail("illegal instruction");
+
+        uint32_t a = regs[d.rs1];
+        uint32_t b = regs[d.rs2];
+        uint32_t imm = static_cast<uint32_t>(d.imm);
+        uint32_t next = pc + 4;
+        uint32_t result = 0;
+        bool writes = true;
+        string_view name = d.name;
+
+        switch (d.format) {
+            case 'R':
+            case 'I': {
+                uint32_t y = d.format == 'R' ? b : imm;
+                string_view op = name;
+                if (d.format == 'I') op = (name == "sltiu") ? "sltu" : name.substr(0, name.size() - 1); // addi -> add
+                if (op == "add") result = a + y;
+                else if (op == "sub") result = a - y;
+                else if (op == "sll") result = a << (y & 31);
+                else if (op == "slt") result = static_cast<int32_t>(a) < static_cast<int32_t>(y);
+                else if (op == "sltu") result = a < y;
+                else if (op == "xor") result = a ^ y;
+                else if (op == "srl") result = a >> (y & 31);
+                else if (op == "sra") result = static_cast<uint32_t>(static_cast<int32_t>(a) >> (y & 31));
+                else if (op == "or") result = a | y;
+                else result = a & y;
+                break;
+            }
+            case 'L': {
+                uint32_t addr = a + imm;
+                if (name == "jalr") {
+                    result = next;
+                    next = addr & ~1u;
+                    break;
+                }
+                int size = (name == "lw") ? 4 : (name == "lh" || name == "lhu") ? 2 : 1;
+                if (addr % size != 0) return fail("misaligned load");
+                result = Read(addr, size);
+                if (name == "lb") result = static_cast<uint32_t>(static_cast<int8_t>(result));
+                if (name == "lh") result = static_cast<uint32_t>(static_cast<int16_t>(result));
+                break;
+            }
+            case 'S': {
+                uint32_t addr = a + imm;
+                int size = (name == "sw") ? 4 : (name == "sh") ? 2 : 1;
+                if (addr % size != 0) return fail("misaligned store");
+                Write(addr, b, size);
+                writes = false;
+                break;
+            }
+            case 'B': {
+                bool taken;
+                if (name == "beq") taken = a == b;
+                else if (name == "bne") taken = a != b;
+                else if (name == "blt") taken = static_cast<int32_t>(a) < static_cast<int32_t>(b);
+                else if (name == "bge") taken = static_cast<int32_t>(a) >= static_cast<int32_t>(b);
+                else if (name == "bltu") taken = a < b;
+                else taken = a >= b;
+                if (taken) next = pc + imm;
+                writes = false;
+                break;
+            }
+            case 'U':
+                result = (name == "lui") ? imm << 12 : pc + (imm << 12);
+                break;
+            case 'J':
+                result = next;
+                next = pc + imm;
+                break;
+            case 'Y':
+                if (name == "ECALL" || name == "EBREAK") {
+                    retired++;
+                    return true;
+                }
+                writes = false; // fences and pause have no architectural effect on one hart
+                break;
+            case 'Z':
+                // csrr rd, mhartid: csrrs/csrrc with x0 read without writing
+                if ((d.imm & 0xFFF) != 0xF14 || d.rs1 != 0 || (name != "csrrs" && name != "csrrc")) {
+                    return fail("unsupported CSR access");
+                }
+                result = hartId;
+                break;
+            default:
+                return fail("unsupported instruction");
+        }
+
+        if (writes && d.rd != 0) regs[d.rd] = result;
+        pc = next;
+        retired++;
+    }
+    return fail("step limit reached");
+}
@@ -0,0 +1,43 @@
+//
+// Small RV32I reference model, used to compute at generation time what a program leaves behind.
+//
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <cstdint>
+
+using namespace std;
+
+
+// Runs from the first loaded instruction until ECALL/EBREAK or until execution falls off
+// the end of the code. The only CSR is a read-only mhartid. Misaligned accesses, illegal words,
+// other CSR accesses and jumps outside the code are errors: the model only answers for programs whose outcome does not depend on traps.
+class Simulator {
+private:
+    uint32_t regs[32] = {};
+    uint32_t pc = 0;
+    uint32_t codeStart = 0;
+    uint32_t codeEnd = 0;
+    uint64_t retired = 0;
+    uint32_t hartId = 0; // what a read of mhartid returns
+    unordered_map<uint32_t, array<uint8_t, 4096>> pages; // sparse little-endian memory
+
+    uint8_t &Byte(uint32_t addr);
+
+public:
+    void LoadCode(uint32_t base, const vector<uint32_t> &words);
+    void SetHartId(uint32_t id) { hartId = id; }
+    bool Run(uint64_t maxSteps, string &error);
+
+    uint32_t Reg(int r) const { return regs[r]; }
+    uint64_t Retired() const { return retired; } // instructions executed by Run()
+    uint32_t Read(uint32_t addr, int bytes);
+    void Write(uint32_t addr, uint32_t value, int bytes);
+};
+
+
+#endif //SIMULATOR_H
@@ -0,0 +1,103 @@
+//
+// Round-trip check of TC and Mem files: decode every word and compare it with the recorded assembly.
+//
+
+#include "Validator.h"
+#include "Disassembler.h"
+#include <iostream>
+#include <mutex>
+#include <cstdio>
+
+using namespace std;
+
+namespace {
+    const size_t MAX_REPORTED = 10;
+    const size_t BATCH = 1024;
+}
+
+ValidationReport Validate(const ParsedImage &tc, const ParsedImage *mem, unsigned threads) {
+    ValidationReport report;
+
+    // the last word of a wide layout is zero padded
+    size_t count = tc.words.size();
+    while (count > 0 && tc.words[count - 1] == 0 && tc.assembly[count - 1].empty()) count--;
+    report.instructions = count;
+
+    mutex merge;
+    ParallelFor(count, threads, [&](size_t first, size_t last) {
+        ValidationReport local;
+        DecodedInstr batch[BATCH];
+
+        for (size_t start = first; start < last; start += BATCH) {
+            size_t n = min(BATCH, last - start);
+            for (size_t j = 0; j < n; ++j) batch[j] = Decode(tc.words[start + j]);
+
+            for (size_t j = 0; j < n; ++j) {
+                size_t i = start + j;
+                bool bad = false;
+
+                if (tc.assembly[i].empty()) {
+                    local.unchecked++;
+                    if (!batch[j].valid) local.illegal++;
+                } else {
+                    ParsedAsm recorded = ParseAssembly(tc.assembly[i]);
+                    if (!recorded.ok) {
+                        local.unchecked++; // a plain comment rather than assembly
+                        if (!batch[j].valid) local.illegal++;
+                    } else if (Matches(batch[j], recorded)) {
+                        local.checked++;
+                    } else {
+                        local.mismatches++;
+                        bad = true;
+                    }
+                }
+
+                if (mem != nullptr && (i >= mem->words.size() || mem->words[i] != tc.words[i])) {
+                    local.memMismatches++;
+                    bad = true;
+                }
+                if (bad && local.firstMismatches.size() < MAX_REPORTED) local.firstMismatches.push_back(i);
+            }
+        }
+
+        lock_guard<mutex> lock(merge);
+        report.checked += local.checked;
+        report.unchecked += local.unchecked;
+        report.mismatches += local.mismatches;
+        report.illegal += local.illegal;
+        report.memMismatches += local.memMismatches;
+        report.firstMismatches.insert(report.firstMismatches.end(), local.firstMismatches.begin(), local.firstMismatches.end());
+    });
+
+    sort(report.firstMismatches.begin(), report.firstMismatches.end());
+    if (report.firstMismatches.size() > MAX_REPORTED) report.firstMismatches.resize(MAX_REPORTED);
+
+    if (mem != nullptr) {
+        size_t memCount = mem->words.size();
+        while (memCount > 0 && mem->words[memCount - 1] == 0) memCount--;
+        if (memCount > count) report.memMismatches += memCount - count;
+    }
+    return report;
+}
+
+void PrintReport(const ValidationReport &report, const ParsedImage &tc, const ParsedImage *mem) {
+    cout << "Instructions: " << report.instructions << " (" << tc.wordBits << "-bit lines)\n";
+    cout << "Matched:      " << report.checked << "\n";
+    cout << "No assembly:  " << report.unchecked << " (" << report.illegal << " not valid RV32I)\n";
+    cout << "Mismatched:   " << report.mismatches << "\n";
+    if (mem != nullptr) {
+        cout << "Mem differs:  " << report.memMismatches << "\n";
+    }
+
+    for (size_t i : report.firstMismatches) {
+        char word[16];
+        snprintf(word, sizeof(word), "0x%08x", tc.words[i]);
+        cout << "  [" << i << "] " << word << " decodes to '" << Disassemble(tc.words[i])
+             << "', recorded '" << tc.assembly[i] << "'";
+        if (mem != nullptr && i < mem->words.size() && mem->words[i] != tc.words[i]) {
+            snprintf(word, sizeof(word), "0x%08x", mem->words[i]);
+            cout << ", Mem file has " << word;
+        }
+        cout << "\n";
+    }
+}
@@ -0,0 +1,29 @@
+//
+// Round-trip check of TC and Mem files: decode every word and compare it with the recorded assembly.
+//
+
+#ifndef VALIDATOR_H
+#define VALIDATOR_H
+#include <vector>
+#include <cstddef>
+#include "ImageReader.h"
+
+using namespace std;
+
+
+struct ValidationReport {
+    size_t instructions = 0;
+    size_t checked = 0;       // decoded word matched its recorded assembly
+    size_t unchecked = 0;     // no assembly recorded for the word
+    size_t mismatches = 0;    // recorded assembly disagrees with the word
+    size_t illegal = 0;       // word without assembly that is not an RV32I instruction
+    size_t memMismatches = 0; // Mem file word differs from the TC file word
+    vector<size_t> firstMismatches; // instruction indices, in order
+};
+
+// mem may be null when only a TC file is checked. Trailing all-zero padding words are ignored.
+ValidationReport Validate(const ParsedImage &tc, const ParsedImage *mem, unsigned threads);
+void PrintReport(const ValidationReport &report, const ParsedImage &tc, const ParsedImage *mem);
+
+
+#endif //VALIDATOR_H
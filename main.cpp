@@ -4,8 +4,21 @@
 #include <algorithm>
 #include <cctype>
 #include <vector>
+#include <stdexcept>
+#include <memory>
+#include <cstdio>
+#include <chrono>
 using namespace std;
 #include "Generator.h"
+#include "ProgramCache.h"
+#include "ImageReader.h"
+#include "Disassembler.h"
+#include "Validator.h"
+#include "Mutator.h"
+#include "Kernels.h"
+#include "Simulator.h"
+#include "Patcher.h"
+#include "MultiHart.h"
 
 static string toUpper(string s) {
     transform(s.begin(), s.end(), s.begin(), [](unsigned char c){ return (char)toupper(c); });
@@ -35,15 +48,449 @@ static char decoder(const string &fmt)
     return '\0';
 }
 
+struct Options {
+    MemLayout layout;
+    bool seeded = false;
+    uint32_t seed = 0;
+    string cacheDir;                     // empty = no program cache
+    uint64_t cacheBytes = 256ull << 20;  // cache size limit before LRU eviction
+    unsigned threads = 0;                // 0 = one per hardware thread
+    int mutations = 4;                   // mutations applied per variant
+    bool selfCheck = false;
+    uint32_t signatureAddress = 0;       // where self-checking programs store their signature
+    KernelParams kernel;
+    MultiHartParams multiHart;
+};
+
+// Parses the optional flags that follow MODE and COUNT:
+// --width 8|16|32|64|128  --endian little|big  --addressing byte|word  --base ADDR  --records fixed|variable
+// --seed N  --cache DIR  --cache-size BYTES  --threads N  --mutations N  --signature ADDR
+// --size N  --unroll N  --reg-base N
+// --memory R  --sharing R  --false-sharing R  --fences R  --lines N  --line-bytes N
+static bool parseOptions(int argc, char **argv, int first, Options &options)
+{
+    MemLayout &layout = options.layout;
+    for (int i = first; i < argc; ++i) {
+        string opt = argv[i];
+        if (i + 1 >= argc) {
+            cout << "Missing value for option '" << opt << "'\n";
+            return false;
+        }
+        string value = argv[++i];
+        try {
+            if (opt == "--width") {
+                layout.wordBits = stoi(value);
+            } else if (opt == "--endian") {
+                string v = toUpper(value);
+                if (v != "LITTLE" && v != "BIG") throw invalid_argument(value);
+                layout.bigEndian = v == "BIG";
+            } else if (opt == "--addressing") {
+                string v = toUpper(value);
+                if (v != "BYTE" && v != "WORD") throw invalid_argument(value);
+                layout.wordAddressed = v == "WORD";
+            } else if (opt == "--records") {
+                string v = toUpper(value);
+                if (v != "FIXED" && v != "VARIABLE") throw invalid_argument(value);
+                layout.fixedRecords = v == "FIXED";
+            } else if (opt == "--base") {
+                layout.baseAddress = stoull(value, nullptr, 0);
+            } else if (opt == "--seed") {
+                options.seed = static_cast<uint32_t>(stoul(value, nullptr, 0));
+                options.seeded = true;
+            } else if (opt == "--cache") {
+                options.cacheDir = value;
+            } else if (opt == "--cache-size") {
+                options.cacheBytes = stoull(value, nullptr, 0);
+            } else if (opt == "--threads") {
+                options.threads = static_cast<unsigned>(stoul(value));
+            } else if (opt == "--mutations") {
+                options.mutations = stoi(value);
+            } else if (opt == "--signature") {
+                uint64_t address = stoull(value, nullptr, 0);
+                if (address % 4 != 0 || address < 256 || address > 0xFFFFFFFCull) throw invalid_argument(value);
+                options.selfCheck = true;
+                options.signatureAddress = static_cast<uint32_t>(address);
+            } else if (opt == "--size") {
+                options.kernel.size = stoi(value);
+            } else if (opt == "--unroll") {
+                options.kernel.unroll = stoi(value);
+            } else if (opt == "--reg-base") {
+                options.kernel.regBase = stoi(value);
+            } else if (opt == "--memory") {
+                options.multiHart.memory = stod(value);
+            } else if (opt == "--sharing") {
+                options.multiHart.sharing = stod(value);
+            } else if (opt == "--false-sharing") {
+                options.multiHart.falseSharing = stod(value);
+            } else if (opt == "--fences") {
+                options.multiHart.fences = stod(value);
+            } else if (opt == "--lines") {
+                options.multiHart.lines = stoi(value);
+            } else if (opt == "--line-bytes") {
+                options.multiHart.lineBytes = stoi(value);
+            } else {
+                cout << "Unknown option '" << opt << "'\n";
+                return false;
+            }
+        } catch (...) {
+            cout << "Invalid value '" << value << "' for option '" << opt << "'\n";
+            return false;
+        }
+    }
+
+    string why;
+    if (!layout.Valid(why)) {
+        cout << "Invalid memory layout: " << why << "\n";
+        return false;
+    }
+    if (!options.cacheDir.empty() && !options.seeded) {
+        cout << "[CACHE] No --seed given, programs are random and will not be cached\n";
+        options.cacheDir.clear();
+    }
+    return true;
+}
+
+// Writes the TC and Mem files, reusing a cached program when one matches the configuration.
+// False if a self-checking program could not be given its signature.
+static bool produce(Generator &gen, ProgramCache *cache)
+{
+    if (cache == nullptr) {
+        if (!gen.GenerateTCFiles()) return false;
+        gen.GenerateMem();
+        return true;
+    }
+
+    // a hit formats the mapped words directly, without rebuilding the program
+    uint64_t key = ProgramCache::Key(gen.ConfigString());
+    CachedProgram program;
+    if (cache->Load(key, program)) {
+        return gen.WriteWords(program.words, program.count, program.texts);
+    }
+    if (!gen.GenerateTCFiles()) return false;
+    gen.GenerateMem();
+    cache->Store(key, gen.Program());
+    return true;
+}
+
+static bool loadImage(const string &path, const Options &options, MappedFile &file, ParsedImage &image)
+{
+    if (!file.Open(path)) {
+        cout << "Could not open " << path << "\n";
+        return false;
+    }
+    string error;
+    if (!ReadImage(file, options.layout.bigEndian, options.threads, image, error)) {
+        cout << path << ": " << error << "\n";
+        return false;
+    }
+    return true;
+}
+
+// DISASM FILE [options]: print every instruction of a TC or Mem file
+static int runDisasm(int argc, char **argv)
+{
+    Options options;
+    if (argc < 3 || !parseOptions(argc, argv, 3, options)) {
+        cout << "Usage: DISASM FILE [--endian little|big] [--threads N]\n";
+        return 1;
+    }
+
+    MappedFile file;
+    ParsedImage image;
+    if (!loadImage(argv[2], options, file, image)) return 1;
+
+    string out;
+    char prefix[40];
+    for (size_t i = 0; i < image.words.size(); ++i) {
+        snprintf(prefix, sizeof(prefix), "%08zx: %08x  ", i * 4, image.words[i]);
+        out += prefix;
+        out += Disassemble(image.words[i]);
+        out += '\n';
+        if (out.size() > (1 << 20)) {
+            fwrite(out.data(), 1, out.size(), stdout);
+            out.clear();
+        }
+    }
+    fwrite(out.data(), 1, out.size(), stdout);
+    return 0;
+}
+
+// VALIDATE TC_FILE [MEM_FILE] [options]: check the words against their assembly comments
+static int runValidate(int argc, char **argv)
+{
+    Options options;
+    int first = (argc > 3 && string(argv[3]).rfind("--", 0) != 0) ? 4 : 3;
+    if (argc < 3 || !parseOptions(argc, argv, first, options)) {
+        cout << "Usage: VALIDATE TC_FILE [MEM_FILE] [--endian little|big] [--threads N]\n";
+        return 1;
+    }
+
+    MappedFile tcFile, memFile;
+    ParsedImage tc, mem;
+    if (!loadImage(argv[2], options, tcFile, tc)) return 1;
+    if (first == 4 && !loadImage(argv[3], options, memFile, mem)) return 1;
+
+    ValidationReport report = Validate(tc, first == 4 ? &mem : nullptr, options.threads);
+    PrintReport(report, tc, first == 4 ? &mem : nullptr);
+    return (report.mismatches == 0 && report.memMismatches == 0) ? 0 : 1;
+}
+
+// MUTATE COUNT FILE... [options]: write COUNT variants of the given TC/Mem programs as TC-V<n>/Mem-V<n>
+static int runMutate(int argc, char **argv)
+{
+    Options options;
+    int count = 0;
+    int first = 3;
+    while (first < argc && string(argv[first]).rfind("--", 0) != 0) first++;
+    try { count = stoi(string(argc > 2 ? argv[2] : "")); } catch (...) { count = 0; }
+    if (count <= 0 || first == 3 || !parseOptions(argc, argv, first, options)) {
+        cout << "Usage: MUTATE COUNT FILE... [--mutations N] [--seed N] [layout options]\n";
+        return 1;
+    }
+
+    uint32_t seed = options.seeded ? options.seed : random_device()();
+    Mutator mutator(seed);
+    for (int i = 3; i < first; ++i) {
+        string error;
+        if (!mutator.AddFile(argv[i], options.layout.bigEndian, options.threads, error)) {
+            cout << argv[i] << ": " << error << "\n";
+            return 1;
+        }
+    }
+    cout << "Loaded " << mutator.CorpusSize() << " corpus programs, seed " << seed << "\n";
+
+    auto start = chrono::steady_clock::now();
+    for (int v = 0; v < count; ++v) {
+        vector<uint32_t> variant = mutator.Mutate(options.mutations);
+        Generator gen('I', static_cast<int>(variant.size()), 'M');
+        gen.SetOutputName("V" + to_string(v));
+        gen.SetMemLayout(options.layout);
+        gen.LoadProgram(Mutator::ToProgram(variant));
+        gen.WriteTCFiles();
+        gen.GenerateMem();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Wrote " << count << " variants in " << seconds << " s\n";
+    return 0;
+}
+
+// Parses "3,10-20" into sorted, distinct instruction indices
+static bool parseIndices(const string &text, vector<size_t> &indices)
+{
+    size_t pos = 0;
+    try {
+        while (pos < text.size()) {
+            size_t comma = text.find(',', pos);
+            string part = text.substr(pos, comma == string::npos ? string::npos : comma - pos);
+            size_t dash = part.find('-');
+            size_t from = stoull(part.substr(0, dash));
+            size_t to = dash == string::npos ? from : stoull(part.substr(dash + 1));
+            if (to < from) return false;
+            for (size_t i = from; i <= to; ++i) indices.push_back(i);
+            pos = comma == string::npos ? text.size() : comma + 1;
+        }
+    } catch (...) {
+        return false;
+    }
+    sort(indices.begin(), indices.end());
+    indices.erase(unique(indices.begin(), indices.end()), indices.end());
+    return !indices.empty();
+}
+
+// PATCH TC_FILE MEM_FILE INDICES [regenerate|mutate] [--seed N]: replace the given instructions of a
+// fixed-record program in place, rewriting only their records
+static int runPatch(int argc, char **argv)
+{
+    Options options;
+    int first = (argc > 5 && string(argv[5]).rfind("--", 0) != 0) ? 6 : 5;
+    string mode = first == 6 ? toUpper(argv[5]) : "REGENERATE";
+    vector<size_t> indices;
+    if (argc < 5 || (mode != "REGENERATE" && mode != "MUTATE") || !parseIndices(argv[4], indices) ||
+        !parseOptions(argc, argv, first, options)) {
+        cout << "Usage: PATCH TC_FILE MEM_FILE INDICES [regenerate|mutate] [--seed N]\n";
+        return 1;
+    }
+
+    Patcher patcher;
+    string error;
+    if (!patcher.Open(argv[2], argv[3], error)) {
+        cout << argv[2] << ": " << error << "\n";
+        return 1;
+    }
+
+    uint32_t seed = options.seeded ? options.seed : random_device()();
+    Generator gen('I', 0, 'M');
+    gen.SetSeed(seed);
+    Mutator mutator(seed);
+
+    auto start = chrono::steady_clock::now();
+    vector<InstructionPatch> patches;
+    patches.reserve(indices.size());
+    for (size_t index : indices) {
+        InstructionPatch patch;
+        patch.index = index;
+        if (!patcher.Read(index, patch.word, error)) {
+            cout << error << "\n";
+            return 1;
+        }
+        if (mode == "MUTATE") {
+            patch.word = mutator.MutateOne(patch.word);
+        } else {
+            // a new instruction of the same format, loads count as I-type
+            char format = Decode(patch.word).format;
+            if (format == 'L' || format == 'Z' || format == '?') format = 'I';
+            patch.word = static_cast<uint32_t>(stoul(gen.GenerateOne(format).first, nullptr, 2));
+        }
+        patch.assembly = Disassemble(patch.word);
+        patches.push_back(std::move(patch));
+    }
+    if (!patcher.Apply(std::move(patches), error)) {
+        cout << error << "\n";
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Patched " << indices.size() << " of " << patcher.Instructions() << " instructions in "
+         << seconds << " s, seed " << seed << "\n";
+    return 0;
+}
+
+// Reference model steps spent counting a kernel's dynamic instructions, a few seconds at most
+static const uint64_t KERNEL_STEP_BUDGET = 100000000ull;
+
+// KERNEL NAME [options]: write a benchmark kernel with its data section as TC-<name>/Mem-<name>
+static int runKernel(int argc, char **argv)
+{
+    Options options;
+    if (argc < 3 || !parseOptions(argc, argv, 3, options)) {
+        cout << "Usage: KERNEL NAME [--size N] [--unroll N] [--reg-base N] [--seed N] [layout options]\n";
+        return 1;
+    }
+
+    string name = argv[2];
+    transform(name.begin(), name.end(), name.begin(), [](unsigned char c){ return (char)tolower(c); });
+    if (options.layout.baseAddress > 0xFFFFFFFFull) {
+        cout << "Kernels need a 32-bit base address\n";
+        return 1;
+    }
+
+    KernelParams params = options.kernel;
+    params.seed = options.seeded ? options.seed : 1;
+    params.baseAddress = static_cast<uint32_t>(options.layout.baseAddress);
+
+    vector<pair<string,string>> program;
+    string error;
+    if (!BuildKernel(name, params, program, error)) {
+        cout << "Kernel " << name << ": " << error << "\n";
+        cout << "Kernels:";
+        for (auto &k : KernelNames()) cout << " " << k;
+        cout << "\n";
+        return 1;
+    }
+
+    Generator gen('I', static_cast<int>(program.size()), 'K');
+    gen.SetOutputName(name);
+    gen.SetMemLayout(options.layout);
+    gen.LoadProgram(std::move(program));
+    gen.WriteTCFiles();
+    gen.GenerateMem();
+    vector<uint32_t> words = gen.Words();
+    cout << "Kernel " << name << ": " << words.size() << " words\n";
+
+    // the dynamic instruction count is informative only, large kernels run past the step budget
+    Simulator sim;
+    sim.LoadCode(params.baseAddress, words);
+    if (sim.Run(KERNEL_STEP_BUDGET, error)) {
+        cout << "Kernel " << name << ": " << sim.Retired() << " instructions executed on the reference model\n";
+    } else if (sim.Retired() >= KERNEL_STEP_BUDGET) {
+        cout << "Kernel " << name << ": instruction count unavailable, more than " << KERNEL_STEP_BUDGET
+             << " instructions\n";
+    } else {
+        cout << "Kernel " << name << " did not finish on the reference model: " << error << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// MULTIHART HARTS COUNT [options]: write one image with COUNT random instructions per hart as TC-H<harts>/Mem-H<harts>
+static int runMultiHart(int argc, char **argv)
+{
+    Options options;
+    MultiHartParams &params = options.multiHart;
+    try {
+        params.harts = stoi(string(argc > 2 ? argv[2] : ""));
+        params.count = stoi(string(argc > 3 ? argv[3] : ""));
+    } catch (...) {
+        params.harts = 0;
+    }
+    if (params.harts <= 0 || !parseOptions(argc, argv, 4, options)) {
+        cout << "Usage: MULTIHART HARTS COUNT [--memory R] [--sharing R] [--false-sharing R] [--fences R] "
+                "[--lines N] [--line-bytes N] [--seed N] [layout options]\n";
+        return 1;
+    }
+    if (options.layout.baseAddress > 0xFFFFFFFFull) {
+        cout << "Multi-hart images need a 32-bit base address\n";
+        return 1;
+    }
+
+    params.seed = options.seeded ? options.seed : random_device()();
+    params.baseAddress = static_cast<uint32_t>(options.layout.baseAddress);
+    vector<pair<string,string>> program;
+    vector<HartSummary> harts;
+    string error;
+    if (!BuildMultiHart(params, program, harts, error)) {
+        cout << "Multi-hart image: " << error << "\n";
+        return 1;
+    }
+
+    // every hart on its own on the reference model, to check that it reaches its ECALL
+    vector<uint32_t> words;
+    for (auto &instr : program) words.push_back(static_cast<uint32_t>(stoul(instr.first, nullptr, 2)));
+    for (int h = 0; h < params.harts; ++h) {
+        Simulator sim;
+        sim.LoadCode(params.baseAddress, words);
+        sim.SetHartId(static_cast<uint32_t>(h));
+        if (!sim.Run(words.size() * 4 + 1000, error)) {
+            cout << "Hart " << h << " did not finish on the reference model: " << error << "\n";
+            return 1;
+        }
+        const HartSummary &s = harts[h];
+        cout << "Hart " << h << ": entry 0x" << hex << params.baseAddress + s.entry * 4 << dec << ", "
+             << s.shared << " shared / " << s.falseShared << " false-shared / " << s.privateAccesses
+             << " private accesses, " << s.fences << " fences, " << sim.Retired() << " instructions executed\n";
+    }
+
+    string name = "H" + to_string(params.harts);
+    Generator gen('I', static_cast<int>(program.size()), 'M');
+    gen.SetOutputName(name);
+    gen.SetMemLayout(options.layout);
+    gen.LoadProgram(std::move(program));
+    gen.WriteTCFiles();
+    gen.GenerateMem();
+    cout << "Multi-hart image " << name << ": " << words.size() << " words, seed " << params.seed << "\n";
+    return 0;
+}
+
 
 int main(int argc, char **argv) {
 
+    if (argc >= 2) {
+        string command = toUpper(argv[1]);
+        if (command == "DISASM") return runDisasm(argc, argv);
+        if (command == "VALIDATE") return runValidate(argc, argv);
+        if (command == "MUTATE") return runMutate(argc, argv);
+        if (command == "KERNEL") return runKernel(argc, argv);
+        if (command == "PATCH") return runPatch(argc, argv);
+        if (command == "MULTIHART") return runMultiHart(argc, argv);
+    }
+
     string mode;
     int count = 16; //default count
+    Options options;
 
     if (argc >= 3) {
         mode = string(argv[1]);
         try { count = stoi(string(argv[2])); } catch (...) { count = 16; }
+        if (!parseOptions(argc, argv, 3, options)) return 1;
     } else {
         // In case user didnt provide enough arguments
         cout << "RISC Random Program Generator - minimal mode\n";
@@ -55,20 +502,34 @@ int main(int argc, char **argv) {
         try { count = stoi(Scount); } catch (...) { count = 16; }
     }
 
+    unique_ptr<ProgramCache> cache;
+    if (!options.cacheDir.empty()) {
+        cache = make_unique<ProgramCache>(options.cacheDir, options.cacheBytes);
+    }
+
+    // the directed I and S sets make misaligned accesses, whose outcome no signature can capture
     string modeUC = toUpper(mode);
+    char fmtChar = decoder(mode);
+    if (options.selfCheck && (modeUC == "ALL" || fmtChar == 'I' || fmtChar == 'S')) {
+        cout << "--signature is not supported for MODE " << mode << ": the I and S sets make misaligned accesses\n";
+        return 1;
+    }
+
     if (modeUC == "ALL") {
         vector<char> allFormats = {'R','I','S','B','U','J'};
         for (char fmt : allFormats) {
             cout << "[DEBUG] Constructing Generator with type='I', count=" << count << ", format='" << fmt << "'\n";
             Generator gen('I', count, fmt);
-            gen.GenerateTCFiles();
-            gen.GenerateMem();
+            gen.SetMemLayout(options.layout);
+            if (options.seeded) gen.SetSeed(options.seed);
+            if (options.selfCheck) gen.SetSelfCheck(options.signatureAddress);
+            if (!produce(gen, cache.get())) return 1;
             cout << "Processed format " << fmt << " with " << count << " instructions.\n";
         }
+        if (cache) cache->Report();
         return 0;
     }
 
-    char fmtChar = decoder(mode);
     if (fmtChar == '\0') {
         cout << "Invalid MODE '" << mode << "'. Valid: R,I,S,B,U,J,M,ALL\n";
         return 1;
@@ -78,9 +539,12 @@ int main(int argc, char **argv) {
     cout << "[DEBUG] Constructing Generator with type='I', count=" << count << ", format='" << fmtChar << "'\n";
 
     Generator gen('I', count, fmtChar);
-    gen.GenerateTCFiles();
-    gen.GenerateMem();
+    gen.SetMemLayout(options.layout);
+    if (options.seeded) gen.SetSeed(options.seed);
+    if (options.selfCheck) gen.SetSelfCheck(options.signatureAddress);
+    if (!produce(gen, cache.get())) return 1;
     cout << "Processed mode " << mode << " with " << count << " instructions.\n";
+    if (cache) cache->Report();
 
 
     return 0;